@@ -0,0 +1,133 @@
+#ifndef __ACCESS_H__
+#define __ACCESS_H__
+
+#include <string.h>
+#include "sim.h"
+#include "pagetable.h"
+#include "window.h"
+#include "tier.h"
+#include "prefetch.h"
+
+/* The page access path, shared by the generic find_physpage() in
+ * pagetable.c and the specialized replay loops in replay.h.
+ *
+ * The replacement algorithm is passed in as function arguments: evict
+ * chooses a victim frame, ref is called on each reference, and flush, if
+ * not NULL, is called before evict (to deliver pending batched refs).
+ * Callers pass constant functions, so once these are inlined the calls
+ * are direct and can be inlined in turn.
+ */
+
+static inline int access_allocate_frame(pgtbl_entry_t *p, int (*evict)(void),
+					void (*flush)(void)) {
+	int frame;
+
+	PROF_START(PROF_ALLOC);
+	frame = find_free_frame();
+	if (frame == -1) { // Didn't find a free page.
+		if (flush != NULL) {
+			flush();
+		}
+		// Call replacement algorithm's evict function to select victim
+		PROF_START(PROF_EVICT);
+		frame = evict();
+		PROF_END(PROF_EVICT);
+		evict_frame(frame);
+	}
+
+	// Record information for virtual page that will now be stored in frame
+	frame_set(coremap.in_use, frame);
+	frame_clear(coremap.referenced, frame);
+	frame_clear(coremap.dirty, frame);
+	coremap.pte[frame] = p;
+	memset(frame_meta(frame), 0, coremap.meta_size);
+	PROF_END(PROF_ALLOC);
+
+	return frame;
+}
+
+/* Looks up vaddr, loading its page on a miss, and records a reference of
+ * the given type (see find_physpage()).
+ */
+static inline char *access_physpage(addr_t vaddr, char type, int (*evict)(void),
+				    void (*flush)(void),
+				    void (*ref)(pgtbl_entry_t *)) {
+	// pointer to the full page table entry for vaddr
+	PROF_START(PROF_WALK);
+	pgtbl_entry_t *p = lookup_pte(vaddr);
+	PROF_END(PROF_WALK);
+	int frame;
+
+	// Check if p is valid or not, on swap or not, and handle appropriately
+	if (!(p->frame & PG_VALID)){
+		if (!(p->frame & PG_FAR)) {
+			miss_count++;
+			if (prefetching) {
+				prefetch_miss(vaddr);
+			}
+		} else if (!tier_promote(p)) {
+			return tier_ref(p, type);
+		}
+		frame = access_allocate_frame(p, evict, flush);
+		load_frame(p, frame, vaddr);
+		if (on_insert_fcn != NULL) {
+			on_insert_fcn(frame, vaddr >> page_shift, type);
+		}
+	} else { // increase hit counter
+		hit_count++;
+		if (p->frame & PG_PREFETCH) {
+			prefetch_hit(p, vaddr);
+		}
+		if (on_hit_fcn != NULL) {
+			on_hit_fcn(p->frame >> PAGE_SHIFT, type);
+		}
+	}
+
+	// Make sure that p is marked valid and referenced. Also mark it
+	// dirty if the access type indicates that the page will be written to.
+	p->frame |= PG_VALID | PG_REF;
+	frame_set(coremap.referenced, p->frame >> PAGE_SHIFT);
+	ref_count++;
+	if (type == 'S' || type == 'M') {
+		pte_set_dirty(p);
+		frame_set(coremap.dirty, p->frame >> PAGE_SHIFT);
+	}
+	if (window_size) {
+		window_ref(p);
+	}
+
+	// Call replacement algorithm's ref function for this page
+	ref(p);
+
+	// Return pointer into (simulated) physical memory at start of frame,
+	// or NULL if there is none (--fast)
+	if (fast) {
+		return NULL;
+	}
+	return &physmem[(size_t)(p->frame >> PAGE_SHIFT) * frame_bytes];
+}
+
+// Brings in the pages queued by the prefetcher that are not in memory
+static inline void access_prefetch_pages(int (*evict)(void), void (*flush)(void)) {
+	pgtbl_entry_t *p;
+	addr_t vaddr;
+	int frame;
+
+	while (prefetch_next(&vaddr)) {
+		p = lookup_pte(vaddr);
+		// A single frame holds the page that was just referenced
+		if (memsize == 1 || (p->frame & (PG_VALID | PG_FAR))) {
+			continue;
+		}
+		p->frame |= PG_PREFETCH;
+		frame = access_allocate_frame(p, evict, flush);
+		load_frame(p, frame, vaddr);
+		p->frame |= PG_VALID;
+		prefetch_loaded(p);
+		if (on_insert_fcn != NULL) {
+			on_insert_fcn(frame, vaddr >> page_shift, 'P');
+		}
+	}
+}
+
+#endif /* __ACCESS_H__ */
@@ -0,0 +1,152 @@
+#!/bin/bash
+# Benchmarks sim with every algorithm and several memory sizes, on
+# synthetic traces and on the traces in traceprogs if there are any. Each
+# configuration is run once to warm up (opt caches its next-use pass) and
+# then RUNS times. Rates are computed from the CPU time sim reports for
+# itself, which varies less than wall-clock time. The median and best
+# references per second are reported with the largest peak RSS of the
+# timed runs and, if perf is available, the instructions per reference,
+# and the results are written as JSON to OUT.
+#
+# If BASELINE names the results of an earlier run, each configuration whose
+# best rate is more than THRESHOLD percent below the baseline's is
+# reported as a regression, and the script exits with status 1. The best
+# rate is compared because interference from other load mostly slows runs
+# down. On a shared machine it comes and goes within seconds, and best-of-7
+# rates of identical builds still differed by up to 36%, so a
+# configuration that falls below the threshold is run up to RETRIES more
+# rounds of RUNS times, and only reported if its best rate over all of
+# them is still below. Raise THRESHOLD where the noise is larger.
+#
+# Usage: [RUNS=7] [THRESHOLD=20] [RETRIES=3] [BASELINE=file] [OUT=file]
+#        [ALGOS=...] [SIZES=...] [SIM_FLAGS=...] ./bench.sh
+
+runs=${RUNS:-7}
+threshold=${THRESHOLD:-20}
+retries=${RETRIES:-3}
+out=${OUT:-bench_results.json}
+algos=${ALGOS:-"rand lru fifo clock opt"}
+sizes=${SIZES:-"16 256 4096"}
+dir=$(mktemp -d bench.XXXXXX)
+trap 'rm -rf $dir' EXIT
+
+# 500000 references each, a quarter of them writes (see tracegen.c): a
+# repeated sequential scan of 8192 pages, uniformly random pages, 90% of
+# references to a hot set of 512 pages, and a Zipf distribution
+gen() {
+	./tracegen -n 500000 -w 0.25 -s 1 -o $dir/$1.ref $2 || exit 1
+}
+gen scan loop:8192
+gen random uniform:8192
+gen hotcold 'uniform:512*0.9+uniform:7680*0.1'
+gen zipf zipf:8192:0.9
+traces="$dir/scan.ref $dir/random.ref $dir/hotcold.ref $dir/zipf.ref $(ls traceprogs/tr-*.ref 2>/dev/null)"
+
+if command -v perf > /dev/null && perf stat -x, -e instructions:u true 2> /dev/null; then
+	have_perf=1
+fi
+
+# Prints the value of the numeric field named $1 in the JSON in file $2
+json_field() {
+	sed -n "s/.*\"$1\": \([0-9.-]*\).*/\1/p" $2
+}
+
+# The baseline's best rate for each configuration
+declare -A base
+if [ -n "$BASELINE" ]; then
+	while read key rate; do
+		base[$key]=$rate
+	done < <(sed -n 's/.*"\([^"]*\)": {.*"best_refs_per_sec": \([0-9.]*\).*/\1 \2/p' $BASELINE)
+fi
+
+# Runs $cmd RUNS times, adding the CPU times to times and keeping the
+# largest peak RSS in rss
+time_runs() {
+	for ((i = 0; i < runs; i++)); do
+		$cmd > $dir/out || exit 1
+		times="$times $(json_field cpu_sec $dir/out)"
+		r=$(json_field peak_rss_kb $dir/out)
+		[ $r -gt $rss ] && rss=$r
+	done
+	read median fastest <<< $(echo $times | tr ' ' '\n' | sort -g |
+		awk '{ t[NR] = $1 } END { print t[int((NR + 1) / 2)], t[1] }')
+	rate=$(awk -v r=$refs -v s=$median 'BEGIN { printf "%.0f", (s > 0 ? r / s : 0) }')
+	best=$(awk -v r=$refs -v s=$fastest 'BEGIN { printf "%.0f", (s > 0 ? r / s : 0) }')
+}
+
+# Succeeds if the best rate for key is more than threshold below baseline
+below_baseline() {
+	[ -n "${base[$key]}" ] && awk -v r=$best -v b=${base[$key]} -v t=$threshold \
+		'BEGIN { exit !(r < b * (1 - t / 100)) }'
+}
+
+echo "{" > $out
+first=1
+for trace in $traces; do
+	name=$(basename $trace .ref)
+	had_sidecar=$([ -e $trace.nextuse ] && echo 1)
+	for algo in $algos; do
+		for size in $sizes; do
+			key="$name/$algo/$size"
+			cmd="./sim -f $trace -m $size -a $algo $SIM_FLAGS --dump json"
+			# The warm-up run may include opt's next-use pass, so
+			# only the timed runs count
+			$cmd > $dir/out || exit 1
+			refs=$(json_field references $dir/out)
+
+			times=""
+			rss=0
+			time_runs
+			for ((retry = 0; retry < retries; retry++)); do
+				below_baseline || break
+				time_runs
+			done
+
+			ipr=null
+			if [ -n "$have_perf" ]; then
+				perf stat -x, -e instructions:u -o $dir/perf $cmd > /dev/null
+				ipr=$(awk -F, -v r=$refs '/instructions/ && $1 ~ /^[0-9]+$/ {
+					printf "%.1f", $1 / r }' $dir/perf)
+				ipr=${ipr:-null}
+			fi
+
+			printf "%-28s %12s refs/s (best %s) %8s KB peak RSS %8s instructions/ref\n" \
+				$key $rate $best $rss $ipr
+			[ -z "$first" ] && echo "," >> $out
+			printf '  "%s": {"refs_per_sec": %s, "best_refs_per_sec": %s, "peak_rss_kb": %s, "instructions_per_ref": %s}' \
+				$key $rate $best $rss $ipr >> $out
+			first=
+		done
+	done
+	[ -z "$had_sidecar" ] && rm -f $trace.nextuse
+done
+printf "\n}\n" >> $out
+echo "Results written to $out"
+
+if [ -n "$BASELINE" ]; then
+	awk -v threshold=$threshold '
+	function parse(line) {
+		if (match(line, /"[^"]*": \{"refs_per_sec": [0-9.]+, "best_refs_per_sec": [0-9.]+/) == 0)
+			return 0
+		s = substr(line, RSTART, RLENGTH)
+		key = substr(s, 2, index(s, "\":") - 2)
+		sub(/.*: /, "", s)
+		rate = s + 0
+		return 1
+	}
+	FNR == NR { if (parse($0)) base[key] = rate; next }
+	parse($0) && (key in base) && base[key] > 0 {
+		change = 100 * (rate - base[key]) / base[key]
+		if (change < -threshold) {
+			printf "REGRESSION: %s best %.0f refs/s, %.1f%% below baseline %.0f\n",
+				key, rate, -change, base[key]
+			status = 1
+		}
+		compared++
+	}
+	END {
+		printf "Compared %d configurations with %s, threshold %s%%\n",
+			compared, ARGV[1], threshold
+		exit status
+	}' $BASELINE $out
+fi
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "sim.h"
+#include "pagetable.h"
+#include "cost.h"
+#include "cleaner.h"
+
+unsigned long clean_next = ULONG_MAX;
+
+static unsigned long clean_every;
+static int clean_pages;
+static int (*victims_fcn)(int *, int);
+static int *candidates;
+static unsigned hand = 0;
+
+static unsigned long passes = 0;
+static unsigned long pages_written = 0;
+static unsigned long evictions_saved = 0;  // cleaned pages evicted clean
+static unsigned long writes_wasted = 0;    // cleaned pages written again
+
+/* Runs the cleaner every 'every' references, writing back up to 'pages'
+ * dirty pages each time. victims is the replacement algorithm's victims
+ * function, or NULL to sweep the coremap instead.
+ */
+void cleaner_init(unsigned long every, int pages, int (*victims)(int *, int)) {
+	clean_every = every;
+	clean_pages = pages;
+	victims_fcn = victims;
+	candidates = malloc(pages * sizeof(int));
+	if (candidates == NULL) {
+		perror("Failed to allocate cleaner");
+		exit(1);
+	}
+	clean_next = every;
+}
+
+// Writes the dirty page in frame to swap, keeping its slot
+static void clean_frame(int frame) {
+	pgtbl_entry_t *p = coremap.pte[frame];
+
+	if (p->frame & PG_CLEANED) {
+		writes_wasted++;
+	}
+	p->swap_off = swap_pageout(frame, p->swap_off);
+	p->frame = (p->frame & ~PG_DIRTY) | PG_CLEANED;
+	frame_clear(coremap.dirty, frame);
+	pages_written++;
+}
+
+/* Writes back dirty pages that are likely to be evicted soon. Called from
+ * the replay loop once ref_count reaches clean_next.
+ */
+void cleaner_run() {
+	unsigned scanned, step;
+	uint64_t word;
+	int i, n;
+
+	clean_next = ref_count + clean_every;
+	passes++;
+	if (victims_fcn != NULL) {
+		n = victims_fcn(candidates, clean_pages);
+		for (i = 0; i < n; i++) {
+			if (frame_test(coremap.dirty, candidates[i])) {
+				clean_frame(candidates[i]);
+			}
+		}
+		return;
+	}
+
+	// Sweep on from where the last pass stopped, a bitmap word at a time
+	for (scanned = 0, n = 0; scanned < memsize && n < clean_pages;
+	     scanned += step) {
+		word = coremap.dirty[hand >> 6] >> (hand & 63);
+		if (word == 0) {
+			step = 64 - (hand & 63);
+		} else {
+			step = __builtin_ctzll(word);
+			clean_frame(hand + step);
+			n++;
+			step++;
+		}
+		hand += step;
+		if (hand >= memsize) {
+			hand = 0;
+		}
+	}
+}
+
+/* Counts the eviction of the cleaned page p, which was either evicted
+ * clean, saving a writeback, or was written again after it was cleaned.
+ */
+void cleaner_evicted(pgtbl_entry_t *p) {
+	if (p->frame & PG_DIRTY) {
+		writes_wasted++;
+	} else {
+		evictions_saved++;
+	}
+	p->frame &= ~PG_CLEANED;
+}
+
+void cleaner_report(FILE *fp) {
+	double saved_ns = evictions_saved *
+		(cost_ns[COST_WRITEBACK] - cost_ns[COST_CLEAN]);
+	double written_ns = pages_written * cost_ns[COST_WRITEBACK];
+
+	fprintf(fp, "\nBackground cleaner: every %lu references, up to %d pages, "
+		"%s\n", clean_every, clean_pages,
+		victims_fcn ? "next victims first" : "sweeping the coremap");
+	fprintf(fp, "Cleaner passes: %lu\n", passes);
+	fprintf(fp, "Pages written by cleaner: %lu\n", pages_written);
+	fprintf(fp, "Dirty evictions avoided: %lu\n", evictions_saved);
+	fprintf(fp, "Cleaner writes wasted (page written again): %lu\n",
+		writes_wasted);
+	fprintf(fp, "Total page writes: %lu (%lu by cleaner, %lu at eviction)\n",
+		swap_writes(), pages_written, swap_writes() - pages_written);
+	fprintf(fp, "Modeled eviction stall avoided (ms): %.3f, "
+		"for background writes (ms): %.3f\n", saved_ns / 1e6,
+		written_ns / 1e6);
+}
@@ -0,0 +1,28 @@
+#ifndef __CLEANER_H__
+#define __CLEANER_H__
+
+#include <stdio.h>
+#include "pagetable.h"
+
+/* Background page cleaner, enabled with sim --clean-every K.
+ *
+ * Every K references the cleaner writes back up to --clean-pages N dirty
+ * pages, chosen from the N frames the replacement algorithm would evict
+ * next if it has a victims function, or else by a hand sweeping the
+ * coremap. A cleaned page keeps its swap slot and has PG_CLEANED set, so
+ * if it is still clean when it is evicted the eviction is clean and needs
+ * no write. If it is written again first, the cleaner's write was wasted.
+ * The cleaner's writes are in the background and are not charged to
+ * --cost latency.
+ */
+
+// Reference count at which the cleaner runs next
+extern unsigned long clean_next;
+
+extern void cleaner_init(unsigned long every, int pages,
+			 int (*victims)(int *, int));
+extern void cleaner_run(void);
+extern void cleaner_evicted(pgtbl_entry_t *p);
+extern void cleaner_report(FILE *fp);
+
+#endif /* __CLEANER_H__ */
@@ -3,31 +3,58 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <stdlib.h>
+#include "sim.h"
 #include "pagetable.h"
 
 
-extern int memsize;
+extern struct coremap coremap;
 
-extern int debug;
-
-extern struct frame *coremap;
+// Next frame the clock hand looks at
+static unsigned hand = 0;
 
 /* Page to evict is chosen using the clock algorithm.
  * Returns the page frame number (which is also the index in the coremap)
  * for the page that is to be evicted.
+ *
+ * The reference bits are coremap.referenced, which find_physpage() sets on
+ * every reference. The hand looks at 64 frames per word of the bitmap: the
+ * first frame from the hand whose bit is clear is the victim, and the bits
+ * of the frames it passed are cleared, giving them their second chance.
  */
 
 int clock_evict() {
-	
-	return 0;
+	uint64_t *referenced = coremap.referenced;
+	uint64_t mask, unreferenced;
+	unsigned word, frame;
+
+	for (;;) {
+		if (hand >= memsize) {
+			hand = 0;
+		}
+		// The frames from the hand to the end of its word, or of memory
+		word = hand >> 6;
+		mask = ~(uint64_t)0 << (hand & 63);
+		if (memsize - (word << 6) < 64) {
+			mask &= ~(~(uint64_t)0 << (memsize & 63));
+		}
+		unreferenced = ~referenced[word] & mask;
+		if (unreferenced != 0) {
+			frame = (word << 6) + __builtin_ctzll(unreferenced);
+			referenced[word] &= ~(mask & (((uint64_t)1 << (frame & 63)) - 1));
+			hand = frame + 1;
+			return frame;
+		}
+		referenced[word] &= ~mask;
+		hand = (word + 1) << 6;
+	}
 }
 
-/* This function is called on each access to a page to update any information
- * needed by the clock algorithm.
- * Input: The page table entry for the page that is being accessed.
+/* This function is called with batches of accessed pages to update any
+ * information needed by the clock algorithm.
+ * Input: The page table entries for the pages accessed, in order.
  */
-void clock_ref(pgtbl_entry_t *p) {
-
+void clock_ref_batch(pgtbl_entry_t **ptes, int n) {
+	// The reference bits are already set in the coremap
 	return;
 }
 
@@ -35,4 +62,10 @@ void clock_ref(pgtbl_entry_t *p) {
  * algorithm. 
  */
 void clock_init() {
+	hand = 0;
 }
+
+#define REPLAY_FN clock_replay
+#define REPLAY_REF_BATCH clock_ref_batch
+#define REPLAY_EVICT clock_evict
+#include "replay.h"
@@ -0,0 +1,33 @@
+#!/bin/bash
+# Times the simulator with a large physical memory, where the cost of
+# scanning the coremap dominates: finding a free frame, opt's scan over all
+# frames for a victim, clock's sweep of the referenced bitmap and the page
+# cleaner's sweep of the dirty bitmap. The trace fills every frame with
+# its own page, writes new pages to force evictions, and then references
+# all of the pages again, so that while the new pages are written every
+# resident page has a next use and opt has to scan the whole coremap, and
+# clock's first eviction finds every reference bit set. rand, which does
+# not scan, is the baseline.
+# Usage: ./coremap_bench.sh [frames] [evictions]
+
+frames=${1:-1000000}
+evictions=${2:-2000}
+trace=$(mktemp coremap_bench.XXXXXX)
+TIMEFORMAT="%R s"
+
+awk -v n=$frames -v e=$evictions 'BEGIN {
+	for (i = 0; i < n; i++) printf "L %x\n", i * 4096
+	for (i = 0; i < e; i++) printf "S %x\n", (n + i) * 4096
+	for (i = 0; i < n + e; i++) printf "L %x\n", i * 4096
+}' > $trace
+
+# The cleaner sweeps the dirty bitmap for up to 64 pages every 1000
+# references; few pages are dirty, so most passes sweep all of it
+for run in "rand" "clock" "opt" "rand --clean-every 1000 --clean-pages 64"; do
+	echo "algo: " $run " frames: " $frames
+	# opt's next-use pass is cached after the first run
+	./sim -f $trace -m $frames -s $((frames + evictions)) -a $run --fast > /dev/null
+	time ./sim -f $trace -m $frames -s $((frames + evictions)) -a $run \
+		--fast | grep -E "^(Hit|Miss) count|^Cleaner passes"
+done
+rm -f $trace $trace.nextuse
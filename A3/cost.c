@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sim.h"
+#include "cost.h"
+
+int cost_model = 0;
+
+// Default costs, roughly a DRAM hit, a page fault that zero-fills the
+// page, and a fault that has to read or write 4K on an SSD. The far tier
+// is a CXL-attached memory with a few times DRAM latency, and migrating
+// a 4K page between tiers costs about as much as a zero-fill.
+double cost_ns[NUM_COST_EVENTS] = {
+	1,        // hit
+	2000,     // cold
+	100000,   // swapin
+	100000,   // writeback
+	0,        // clean
+	3,        // far
+	2000,     // promote
+	2000      // demote
+};
+
+static const char *cost_names[NUM_COST_EVENTS] = {
+	"hit", "cold", "swapin", "writeback", "clean", "far", "promote",
+	"demote"
+};
+
+//---------------------------------------------------------------------
+// Log-bucketed histogram of miss service times. Each power of two is
+// split into HIST_SUB buckets, so a bucket's bounds are within 2^(1/4)
+// (about 19%) of each other.
+
+#define HIST_SUB      4
+#define HIST_OCTAVES  48
+#define HIST_BUCKETS  (HIST_OCTAVES * HIST_SUB)
+
+static unsigned long miss_hist[HIST_BUCKETS];
+static double miss_hist_sum[HIST_BUCKETS];
+static double miss_total_ns = 0;
+static double extra_total_ns = 0;  // see cost_add()
+
+static int hist_bucket(double ns) {
+	int b;
+
+	if (ns < 1) {
+		return 0;
+	}
+	b = (int)(log2(ns) * HIST_SUB);
+	return b < HIST_BUCKETS ? b : HIST_BUCKETS - 1;
+}
+
+// Upper bound of bucket b
+static double hist_bound(int b) {
+	return exp2((double)(b + 1) / HIST_SUB);
+}
+
+/* Parses a cost model of the form "hit=1,swapin=100us,..." into cost_ns.
+ * Values are in ns unless followed by "us" or "ms". Events that are not
+ * given keep their default cost. Returns 0 on success, -1 on error.
+ */
+int cost_init(char *spec) {
+	char *item, *save = NULL;
+	int i;
+
+	cost_model = 1;
+	if (spec == NULL) {
+		return 0;
+	}
+	for (item = strtok_r(spec, ",", &save); item != NULL;
+	     item = strtok_r(NULL, ",", &save)) {
+		char *eq = strchr(item, '=');
+		char *end;
+		double val;
+
+		if (eq == NULL) {
+			fprintf(stderr, "Error: cost model entry %s has no value\n",
+				item);
+			return -1;
+		}
+		*eq = '\0';
+		val = strtod(eq + 1, &end);
+		if (strcmp(end, "us") == 0) {
+			val *= 1000;
+		} else if (strcmp(end, "ms") == 0) {
+			val *= 1000000;
+		} else if (*end != '\0' && strcmp(end, "ns") != 0) {
+			fprintf(stderr, "Error: bad cost %s for %s\n", eq + 1, item);
+			return -1;
+		}
+
+		for (i = 0; i < NUM_COST_EVENTS; i++) {
+			if (strcmp(item, cost_names[i]) == 0) {
+				cost_ns[i] = val;
+				break;
+			}
+		}
+		if (i == NUM_COST_EVENTS) {
+			fprintf(stderr, "Error: unknown cost model event %s\n", item);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Records the service time of one miss, not counting the hit time that
+ * every reference pays.
+ */
+void cost_miss(double service_ns) {
+	int b = hist_bucket(service_ns);
+
+	miss_hist[b]++;
+	miss_hist_sum[b] += service_ns;
+	miss_total_ns += service_ns;
+}
+
+/* Returns the latency at quantile q of all references. Hits all cost
+ * cost_ns[COST_HIT]; a miss costs that plus its service time. Misses are
+ * reported as the mean of the bucket the quantile falls in.
+ */
+static double ref_quantile(double q) {
+	unsigned long rank = (unsigned long)ceil(q * ref_count);
+	unsigned long seen = hit_count;
+	int b;
+
+	if (rank <= seen) {
+		return cost_ns[COST_HIT];
+	}
+	for (b = 0; b < HIST_BUCKETS; b++) {
+		seen += miss_hist[b];
+		if (seen >= rank) {
+			return cost_ns[COST_HIT] + miss_hist_sum[b] / miss_hist[b];
+		}
+	}
+	return cost_ns[COST_HIT];
+}
+
+/* Records time that is neither a hit nor a miss, such as far-tier
+ * references and promotions.
+ */
+void cost_add(double ns) {
+	extra_total_ns += ns;
+}
+
+void cost_report(FILE *fp) {
+	double total_ns = (double)ref_count * cost_ns[COST_HIT] + miss_total_ns +
+		extra_total_ns;
+	int b;
+
+	fprintf(fp, "\nCost model:");
+	for (b = 0; b < NUM_COST_EVENTS; b++) {
+		fprintf(fp, " %s=%gns", cost_names[b], cost_ns[b]);
+	}
+	fprintf(fp, "\nMiss service time histogram (ns):\n");
+	for (b = 0; b < HIST_BUCKETS; b++) {
+		if (miss_hist[b] != 0) {
+			fprintf(fp, "  [%12.0f, %12.0f) %10lu\n",
+				b == 0 ? 0 : hist_bound(b - 1), hist_bound(b),
+				miss_hist[b]);
+		}
+	}
+	fprintf(fp, "Estimated runtime (ms): %.3f\n", total_ns / 1e6);
+	fprintf(fp, "Mean reference latency (ns): %.2f\n",
+		ref_count ? total_ns / ref_count : 0);
+	fprintf(fp, "Reference latency p50/p99/p999 (ns): %.0f / %.0f / %.0f\n",
+		ref_quantile(0.5), ref_quantile(0.99), ref_quantile(0.999));
+}
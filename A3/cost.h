@@ -0,0 +1,36 @@
+#ifndef __COST_H__
+#define __COST_H__
+
+#include <stdio.h>
+
+/* Modeled cost of memory references, enabled with sim --cost.
+ *
+ * Every reference costs the hit time. A miss additionally costs either a
+ * cold fill (init_frame) or a swap-in, plus the write-out of the victim
+ * if a frame had to be evicted for it. Costs are in nanoseconds.
+ *
+ * With a far memory tier, references served there and page migrations
+ * add to the estimated runtime and mean latency, but the percentiles
+ * treat every hit as costing the hit time.
+ */
+enum cost_event {
+	COST_HIT,        // any reference
+	COST_COLD,       // first reference to a page (zero-filled frame)
+	COST_SWAPIN,     // page read back from swap
+	COST_WRITEBACK,  // dirty victim written to swap
+	COST_CLEAN,      // clean victim evicted
+	COST_FAR,        // reference served by the far memory tier (tier.h)
+	COST_PROMOTE,    // page moved from the far to the fast tier
+	COST_DEMOTE,     // page moved from the fast to the far tier
+	NUM_COST_EVENTS
+};
+
+extern int cost_model;
+extern double cost_ns[NUM_COST_EVENTS];
+
+extern int cost_init(char *spec);
+extern void cost_miss(double service_ns);
+extern void cost_add(double ns);
+extern void cost_report(FILE *fp);
+
+#endif /* __COST_H__ */
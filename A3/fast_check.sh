@@ -0,0 +1,23 @@
+#!/bin/bash
+# Checks that sim --fast reports the same counts as a full simulation for
+# every algorithm and a range of memory sizes on each trace. Prints one line
+# per run that differs and exits with status 1 if there were any.
+# Usage: ./fast_check.sh [traces...]
+
+traces=${@:-./traceprogs/tr-*.ref}
+status=0
+
+for trace in $traces; do
+	for algo in rand lru fifo clock opt; do
+		for size in 1 8 50 100 200; do
+			full=$(./sim -f $trace -m $size -s 20000 -a $algo | tail --lines=7)
+			fast=$(./sim -f $trace -m $size -s 20000 -a $algo --fast | tail --lines=7)
+			if [ "$full" != "$fast" ]; then
+				echo "MISMATCH: $trace -a $algo -m $size"
+				status=1
+			fi
+		done
+	done
+	echo "checked: " $trace
+done
+exit $status
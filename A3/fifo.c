@@ -3,35 +3,69 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <stdlib.h>
+#include "sim.h"
 #include "pagetable.h"
+#include "framelist.h"
 
 
-extern int memsize;
+extern struct coremap coremap;
 
-extern int debug;
-
-extern struct frame *coremap;
+// Frames in the order their pages came in, oldest first
+static struct framelist order;
 
 /* Page to evict is chosen using the fifo algorithm.
  * Returns the page frame number (which is also the index in the coremap)
  * for the page that is to be evicted.
  */
 int fifo_evict() {
-	
-	return 0;
+	return order.head;
 }
 
-/* This function is called on each access to a page to update any information
- * needed by the fifo algorithm.
- * Input: The page table entry for the page that is being accessed.
+/* This function is called with batches of accessed pages to update any
+ * information needed by the fifo algorithm.
+ * Input: The page table entries for the pages accessed, in order.
  */
-void fifo_ref(pgtbl_entry_t *p) {
-
+void fifo_ref_batch(pgtbl_entry_t **ptes, int n) {
+	// The order only changes when pages come in or leave (see the events)
 	return;
 }
 
+/* The frames fifo_evict would choose next, for the page cleaner.
+ */
+int fifo_victims(int *frames, int n) {
+	return framelist_first(&order, frames, n);
+}
+
+/* Frame events (see policy.h), which keep the order of the pages.
+ */
+void fifo_on_insert(int frame, addr_t vpage, char type) {
+	framelist_push(&order, frame);
+}
+
+void fifo_on_evict(int frame, int dirty) {
+	framelist_remove(&order, frame);
+}
+
+void fifo_on_move(int from, int to) {
+	framelist_replace(&order, from, to);
+}
+
+void fifo_on_free(int frame) {
+	framelist_remove(&order, frame);
+}
+
 /* Initialize any data structures needed for this 
  * replacement algorithm 
  */
 void fifo_init() {
+	framelist_init(&order, memsize);
+}
+
+void fifo_destroy() {
+	framelist_destroy(&order);
 }
+
+#define REPLAY_FN fifo_replay
+#define REPLAY_REF_BATCH fifo_ref_batch
+#define REPLAY_EVICT fifo_evict
+#include "replay.h"
@@ -0,0 +1,115 @@
+#ifndef __FRAMELIST_H__
+#define __FRAMELIST_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* A doubly linked list of frames, from the head (oldest) to the tail
+ * (newest), used by fifo and lru to order the resident pages. The links
+ * are arrays indexed by frame number, so each operation is O(1) and a
+ * frame is in the list at most once. -1 ends the list, and prev is
+ * FRAMELIST_OUT for a frame that is not in it.
+ */
+
+#define FRAMELIST_OUT (-2)
+
+struct framelist {
+	int *prev;
+	int *next;
+	int head;
+	int tail;
+};
+
+static inline void framelist_init(struct framelist *l, unsigned nframes) {
+	unsigned i;
+
+	l->prev = malloc(nframes * sizeof(int));
+	l->next = malloc(nframes * sizeof(int));
+	if (l->prev == NULL || l->next == NULL) {
+		perror("Failed to allocate frame list");
+		exit(1);
+	}
+	for (i = 0; i < nframes; i++) {
+		l->prev[i] = FRAMELIST_OUT;
+	}
+	l->head = l->tail = -1;
+}
+
+static inline void framelist_destroy(struct framelist *l) {
+	free(l->prev);
+	free(l->next);
+}
+
+// Appends frame, which is not in the list, at the tail
+static inline void framelist_push(struct framelist *l, int frame) {
+	l->prev[frame] = l->tail;
+	l->next[frame] = -1;
+	if (l->tail != -1) {
+		l->next[l->tail] = frame;
+	} else {
+		l->head = frame;
+	}
+	l->tail = frame;
+}
+
+// Removes frame from the list, if it is in it
+static inline void framelist_remove(struct framelist *l, int frame) {
+	int prev = l->prev[frame], next = l->next[frame];
+
+	if (prev == FRAMELIST_OUT) {
+		return;
+	}
+	if (prev != -1) {
+		l->next[prev] = next;
+	} else {
+		l->head = next;
+	}
+	if (next != -1) {
+		l->prev[next] = prev;
+	} else {
+		l->tail = prev;
+	}
+	l->prev[frame] = FRAMELIST_OUT;
+}
+
+// Moves frame, which is in the list, to the tail
+static inline void framelist_touch(struct framelist *l, int frame) {
+	if (l->tail != frame) {
+		framelist_remove(l, frame);
+		framelist_push(l, frame);
+	}
+}
+
+// Puts frame 'to', which is not in the list, in the place of 'from'
+static inline void framelist_replace(struct framelist *l, int from, int to) {
+	int prev = l->prev[from], next = l->next[from];
+
+	if (prev == FRAMELIST_OUT) {
+		return;
+	}
+	l->prev[to] = prev;
+	l->next[to] = next;
+	if (prev != -1) {
+		l->next[prev] = to;
+	} else {
+		l->head = to;
+	}
+	if (next != -1) {
+		l->prev[next] = to;
+	} else {
+		l->tail = to;
+	}
+	l->prev[from] = FRAMELIST_OUT;
+}
+
+// Fills frames with up to n frames from the head, returning the number
+static inline int framelist_first(struct framelist *l, int *frames, int n) {
+	int frame, count = 0;
+
+	for (frame = l->head; frame != -1 && count < n; frame = l->next[frame]) {
+		frames[count++] = frame;
+	}
+	return count;
+}
+
+#endif /* __FRAMELIST_H__ */
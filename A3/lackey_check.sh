@@ -0,0 +1,54 @@
+#!/bin/bash
+# Checks that sim and reusedist read raw Valgrind lackey output: the
+# results must be the same as for the reduced trace of the same references,
+# and a reference outside the simulated address space must be rejected by
+# sim with its line number but measured by reusedist, which has no page
+# table. Exits with status 1 if a check fails.
+
+dir=$(mktemp -d lackey_check.XXXXXX)
+trap 'rm -rf $dir' EXIT
+status=0
+
+cat > $dir/lackey.out <<'END'
+==1234== Lackey, an example Valgrind tool
+==1234== Command: ./prog
+I  0400d7d4,3
+ L 04222cac,4
+ S 04223000,8
+I  0400d7d7,5
+ M 04222ff8,8
+program output
+ L 7ff000010,4
+I  0401a000,2
+ S 04224010,4
+END
+awk '$1 ~ /^[ILSM]$/ { split($2, a, ","); printf "%s %s\n", $1, a[1] }' \
+	$dir/lackey.out > $dir/reduced.ref
+
+for algo in rand fifo; do
+	raw=$(./sim -f $dir/lackey.out -m 2 -a $algo | tail --lines=7)
+	reduced=$(./sim -f $dir/reduced.ref -m 2 -a $algo | tail --lines=7)
+	if [ "$raw" != "$reduced" ]; then
+		echo "MISMATCH: lackey and reduced traces, -a $algo"
+		status=1
+	fi
+done
+if ! ./reusedist -f $dir/lackey.out | cmp -s - <(./reusedist -f $dir/reduced.ref); then
+	echo "MISMATCH: lackey and reduced traces, reusedist"
+	status=1
+fi
+
+# valgrind's stack is above the 36-bit address space of the page table
+line=$(($(wc -l < $dir/lackey.out) + 1))
+(cat $dir/lackey.out; echo " S 1ffefffc58,1") > $dir/stack.out
+if ./sim -f $dir/stack.out -m 2 -a rand > /dev/null 2> $dir/err ||
+   ! grep -q "line $line:" $dir/err; then
+	echo "FAILED: out-of-range address not rejected at line $line"
+	status=1
+fi
+if ! ./reusedist -f $dir/stack.out | grep -q "^Distinct pages: $(($(
+	./reusedist -f $dir/lackey.out | awk '/^Distinct/ { print $3 }') + 1))$"; then
+	echo "FAILED: reusedist did not measure the stack address"
+	status=1
+fi
+exit $status
@@ -3,14 +3,15 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <stdlib.h>
+#include "sim.h"
 #include "pagetable.h"
+#include "framelist.h"
 
 
-extern int memsize;
+extern struct coremap coremap;
 
-extern int debug;
-
-extern struct frame *coremap;
+// Frames from the least to the most recently used
+static struct framelist recency;
 
 /* Page to evict is chosen using the accurate LRU algorithm.
  * Returns the page frame number (which is also the index in the coremap)
@@ -18,8 +19,7 @@ extern struct frame *coremap;
  */
 
 int lru_evict() {
-	
-	return 0;
+	return recency.head;
 }
 
 /* This function is called on each access to a page to update any information
@@ -27,8 +27,33 @@ int lru_evict() {
  * Input: The page table entry for the page that is being accessed.
  */
 void lru_ref(pgtbl_entry_t *p) {
+	framelist_touch(&recency, p->frame >> PAGE_SHIFT);
+}
+
+/* The frames lru_evict would choose next, for the page cleaner.
+ */
+int lru_victims(int *frames, int n) {
+	return framelist_first(&recency, frames, n);
+}
 
-	return;
+/* Frame events (see policy.h). A page is added when it comes in, which
+ * covers prefetched pages that have not been referenced yet; lru_ref
+ * then moves it on each reference.
+ */
+void lru_on_insert(int frame, addr_t vpage, char type) {
+	framelist_push(&recency, frame);
+}
+
+void lru_on_evict(int frame, int dirty) {
+	framelist_remove(&recency, frame);
+}
+
+void lru_on_move(int from, int to) {
+	framelist_replace(&recency, from, to);
+}
+
+void lru_on_free(int frame) {
+	framelist_remove(&recency, frame);
 }
 
 
@@ -36,4 +61,14 @@ void lru_ref(pgtbl_entry_t *p) {
  * replacement algorithm 
  */
 void lru_init() {
+	framelist_init(&recency, memsize);
 }
+
+void lru_destroy() {
+	framelist_destroy(&recency);
+}
+
+#define REPLAY_FN lru_replay
+#define REPLAY_REF lru_ref
+#define REPLAY_EVICT lru_evict
+#include "replay.h"
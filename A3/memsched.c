@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "sim.h"
+#include "pagetable.h"
+#include "memsched.h"
+
+unsigned long sched_next = ULONG_MAX;
+
+struct resize {
+	unsigned long ref;
+	unsigned frames;
+};
+
+static struct resize *entries;
+static int num_entries = 0, next_entry = 0;
+static unsigned initial_frames;
+
+// Counter values at the start of each phase
+struct phase {
+	unsigned long start_ref, hits, misses, clean, dirty, forced;
+	unsigned frames;
+};
+
+static struct phase *phases;
+static int num_phases = 0;
+
+/* Reads the schedule in path, with frame counts multiplied by scale (see
+ * --sample-rate), for a run that starts with initial frames. Returns the
+ * largest number of frames the run needs.
+ */
+unsigned memsched_init(char *path, double scale, unsigned initial) {
+	FILE *fp = fopen(path, "r");
+	char line[256], *p;
+	unsigned long ref, frames, max = initial;
+	int cap = 16, lineno = 0;
+
+	if (fp == NULL) {
+		perror("Error opening memory schedule:");
+		exit(1);
+	}
+	entries = malloc(cap * sizeof(struct resize));
+	while (entries != NULL && fgets(line, sizeof(line), fp) != NULL) {
+		lineno++;
+		for (p = line; *p == ' ' || *p == '\t'; p++)
+			;
+		if (*p == '#' || *p == '\n' || *p == '\0') {
+			continue;
+		}
+		if (sscanf(p, "%lu %lu", &ref, &frames) != 2 || frames == 0 ||
+		    frames > UINT_MAX ||
+		    (num_entries > 0 && ref < entries[num_entries - 1].ref)) {
+			fprintf(stderr, "Error: %s line %d: expected increasing "
+				"\"<references> <frames>\" with frames > 0\n",
+				path, lineno);
+			exit(1);
+		}
+		frames = (unsigned long)(frames * scale + 0.5);
+		if (frames == 0) {
+			frames = 1;
+		}
+		if (num_entries == cap) {
+			cap *= 2;
+			entries = realloc(entries, cap * sizeof(struct resize));
+			if (entries == NULL) {
+				break;
+			}
+		}
+		entries[num_entries].ref = ref;
+		entries[num_entries].frames = frames;
+		num_entries++;
+		if (frames > max) {
+			max = frames;
+		}
+	}
+	fclose(fp);
+	phases = malloc((num_entries + 1) * sizeof(struct phase));
+	if (entries == NULL || phases == NULL) {
+		perror("Failed to allocate memory schedule");
+		exit(1);
+	}
+	initial_frames = initial;
+	return max;
+}
+
+// Resizes the memory to frames, starting a new phase
+static void resize(unsigned frames) {
+	struct phase *ph;
+
+	// Resizes before any reference in a phase replace it
+	if (num_phases == 0 || phases[num_phases - 1].start_ref != ref_count) {
+		ph = &phases[num_phases++];
+		ph->start_ref = ref_count;
+		ph->hits = hit_count;
+		ph->misses = miss_count;
+		ph->clean = evict_clean_count;
+		ph->dirty = evict_dirty_count;
+		ph->forced = 0;
+	}
+	ph = &phases[num_phases - 1];
+	ph->frames = frames;
+	ph->forced += resize_coremap(frames);
+}
+
+/* Shrinks the memory from its largest size to the initial size, once the
+ * replacement algorithm has been initialized.
+ */
+void memsched_start() {
+	resize(initial_frames);
+	memsched_run();
+}
+
+/* Applies the resizes that are due. Called from the replay loop once
+ * ref_count reaches sched_next.
+ */
+void memsched_run() {
+	while (next_entry < num_entries && entries[next_entry].ref <= ref_count) {
+		resize(entries[next_entry++].frames);
+	}
+	sched_next = next_entry < num_entries ? entries[next_entry].ref : ULONG_MAX;
+}
+
+void memsched_report(FILE *fp) {
+	struct phase *ph, *nx, end;
+	unsigned long refs, hits;
+	int i;
+
+	end.start_ref = ref_count;
+	end.hits = hit_count;
+	end.misses = miss_count;
+	end.clean = evict_clean_count;
+	end.dirty = evict_dirty_count;
+
+	fprintf(fp, "\nMemory schedule: %d phases\n", num_phases);
+	fprintf(fp, "%12s %10s %12s %12s %12s %8s %12s %10s\n", "start", "frames",
+		"references", "hits", "misses", "hit%", "evictions", "forced");
+	for (i = 0; i < num_phases; i++) {
+		ph = &phases[i];
+		nx = i + 1 < num_phases ? &phases[i + 1] : &end;
+		refs = nx->start_ref - ph->start_ref;
+		hits = nx->hits - ph->hits;
+		fprintf(fp, "%12lu %10u %12lu %12lu %12lu %8.2f %12lu %10lu\n",
+			ph->start_ref, ph->frames, refs, hits, nx->misses - ph->misses,
+			refs ? 100.0 * hits / refs : 0.0,
+			nx->clean - ph->clean + nx->dirty - ph->dirty, ph->forced);
+	}
+}
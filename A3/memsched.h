@@ -0,0 +1,28 @@
+#ifndef __MEMSCHED_H__
+#define __MEMSCHED_H__
+
+#include <stdio.h>
+
+/* Memory limit schedule, enabled with sim --mem-schedule file.
+ *
+ * Each line of the file is "<references> <frames>": once that many
+ * references have been replayed, the memory is resized to that many
+ * frames. Blank lines and lines starting with '#' are skipped. The run
+ * starts with -m frames. Growing adds free frames; shrinking evicts pages
+ * chosen by the replacement algorithm (see resize_coremap()). The coremap
+ * is allocated for the largest size, and memsize is that size while the
+ * algorithm's init function runs.
+ *
+ * Each resize starts a new phase, and the counts for each phase are
+ * reported at the end.
+ */
+
+// Reference count at which the memory is resized next
+extern unsigned long sched_next;
+
+extern unsigned memsched_init(char *path, double scale, unsigned initial);
+extern void memsched_start(void);
+extern void memsched_run(void);
+extern void memsched_report(FILE *fp);
+
+#endif /* __MEMSCHED_H__ */
@@ -0,0 +1,37 @@
+#!/bin/bash
+# Compares the sampled LRU miss ratio curve (sim --sample-rate) against the
+# exact one (rate 1, no page limit) for each trace, printing the error at
+# each cache size and whether the exact value is inside the error bounds.
+# Usage: ./mrc_check.sh [rate] [traces...]
+
+rate=${1:-0.1}
+shift
+traces=${@:-./traceprogs/tr-*.ref}
+
+mrc() {
+	./sim -f $1 -m 100 -s 20000 -a rand --sample-rate $2 --sample-max $3 |
+		awk '/^LRU miss ratio curve/ {on=1; getline; next}
+		     on && NF == 3 {print $1, $2, $3}
+		     on && NF != 3 {on=0}'
+}
+
+for trace in $traces; do
+	echo "****************************************************"
+	echo "trace: " $trace
+	echo "rate: " $rate
+	echo "****************************************************"
+	mrc $trace 1 0 > exact.mrc
+	mrc $trace $rate 8192 > sampled.mrc
+	awk '
+		BEGIN {printf "%12s %10s %10s %10s %6s\n", "frames", "exact", "sampled", "+/- 95%", "in"}
+		NR == FNR {exact[$1] = $2; next}
+		$1 in exact {
+			err = $2 - exact[$1]; if (err < 0) err = -err
+			in_bounds = (err <= $3) ? "yes" : "no"
+			printf "%12d %10.4f %10.4f %10.4f %6s\n", $1, exact[$1], $2, $3, in_bounds
+			sum += err; if (err > max) max = err; n++; hits += (in_bounds == "yes")
+		}
+		END {if (n) printf "mean abs error %.4f, max abs error %.4f, %d of %d sizes within bounds\n", sum/n, max, hits, n}' exact.mrc sampled.mrc
+	rm -f exact.mrc sampled.mrc
+	echo " "
+done
@@ -3,38 +3,61 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sim.h"
 #include "pagetable.h"
+#include "traceio.h"
 
-#define MAXLINE 256
 
-extern int memsize;
+extern struct coremap coremap;
 
-extern int debug;
-
-extern struct frame *coremap;
+/* OPT needs, for every reference, the position of the next reference to
+ * the same page. opt_init() computes this next-use array with one backward
+ * pass over the trace and saves it in a sidecar file next to the trace,
+ * <tracefile>.nextuse. Later runs on the same trace, e.g. with other
+ * memory sizes, map the sidecar instead of recomputing it. The sidecar's
+ * header records the size and a hash of the trace file's contents, and a
+ * stale or damaged sidecar is regenerated. It is written to a temporary
+ * file and renamed into place, so concurrent runs never see a partial one.
+ */
 
-extern char *tracefile;
+#define NEXTUSE_MAGIC    "OPTNEXT"
+#define NEXTUSE_VERSION  1
+#define NEXTUSE_DEDUP    0x1    // computed from a trace filtered by --dedup
+#define NEXTUSE_SHIFT    8      // flags bits 8-15 hold the page_shift used
+#define HASH_BUFSIZE     (1 << 20)
 
-int next_occurrence(addr_t vaddr, int line_num,1 FILE *file);
+// Next reference to the page in a frame, kept in the frame's meta data
+#define NEXT_POS(frame)  (((long *)coremap.meta)[frame])
 
-char *POSITION_FILE = "pos.txt";
-long offset;
-typedef struct node {
-    int next_pos; // position of next occurrence
-    struct node *next;
-} Node;
+struct nextuse_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t trace_size;
+    uint64_t trace_hash;
+    uint64_t count;          // number of entries that follow
+};
 
-Node *head;
-Node *tail;
+static const int64_t *next_use;   // next reference to the same page, or -1
+static uint64_t num_refs;
+static void *map_addr = NULL;
+static size_t map_len;
 
-/* Page to evict is chosen using the optimal (aka MIN) algorithm. 
+/* Page to evict is chosen using the optimal (aka MIN) algorithm.
  * Returns the page frame number (which is also the index in the coremap)
  * for the page that is to be evicted.
  */
 int opt_evict() {
-    int i, next_pos, max_next_pos = 0, frame;
+    unsigned i;
+    int frame = 0;
+    long next_pos, max_next_pos = 0;
 	for (i = 0; i < memsize; i++) {
-        next_pos = coremap[i].next_pos;
+        next_pos = NEXT_POS(i);
         if (next_pos == -1) { // never occurring again, no need to continue
             frame = i;
             break;
@@ -44,119 +67,266 @@ int opt_evict() {
             frame = i;
         }
     }
-    printf("evicted %d\n", frame);
+    if (debug) {
+        printf("evicted %d\n", frame);
+    }
 	return frame;
 }
 
+/* Fills frames with up to n frames, in the order opt_evict would choose
+ * them, for the page cleaner (see cleaner.h). Returns the number of frames.
+ */
+int opt_victims(int *frames, int n) {
+    static long *keys = NULL;
+    static int cap = 0;
+    unsigned i;
+    int j, count = 0;
+    long key;
+
+    if (n > cap) {
+        if ((keys = realloc(keys, n * sizeof(long))) == NULL) {
+            perror("Failed to allocate opt tables");
+            exit(1);
+        }
+        cap = n;
+    }
+    // Insertion into the list of the n furthest next uses so far, where
+    // pages that are never used again come first
+    for (i = 0; i < memsize; i++) {
+        if (!frame_test(coremap.in_use, i)) {
+            continue;
+        }
+        key = NEXT_POS(i) == -1 ? LONG_MAX : NEXT_POS(i);
+        if (count == n && key <= keys[n - 1]) {
+            continue;
+        }
+        for (j = count < n ? count++ : n - 1; j > 0 && keys[j - 1] < key; j--) {
+            keys[j] = keys[j - 1];
+            frames[j] = frames[j - 1];
+        }
+        keys[j] = key;
+        frames[j] = i;
+    }
+    return count;
+}
+
 /* This function is called on each access to a page to update any information
  * needed by the opt algorithm.
  * Input: The page table entry for the page that is being accessed.
  */
 void opt_ref(pgtbl_entry_t *p) {
-    char buff[MAXLINE];
-    int next_line_num;
     int frame = p->frame >> PAGE_SHIFT;
 
-    FILE *positions = fopen(POSITION_FILE, "r");
-    if (!positions) {
-        perror("Error opening POSITION_FILE:");
+    // ref_count already counts this reference. Using it rather than a
+    // count of calls keeps the position right when a reference is served
+    // by the far tier (see tier.h) without calling opt_ref.
+    if (ref_count > num_refs) {
+        fprintf(stderr, "opt: trace is longer than when opt_init read it\n");
         exit(1);
     }
+    NEXT_POS(frame) = next_use[ref_count - 1];
+}
+
+/* Hashes the contents of the trace file, 8 bytes at a time, and returns
+ * its size in *size.
+ */
+static uint64_t hash_trace(const char *path, uint64_t *size) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL, word;
+    unsigned char *buf = malloc(HASH_BUFSIZE);
+    size_t n, i;
+    FILE *file = fopen(path, "r");
 
-    fseek(positions, offset, SEEK_SET);
-
-    fgets(buff, MAXLINE, positions);
-    sscanf(buff, "%d", &next_line_num);
-    coremap[frame].next_pos = next_line_num;
-    printf("next line %d\n", next_line_num);
-    offset = ftell(positions);
-    fclose(positions);
-//    coremap[frame].next_pos = head->next_pos;
-//    Node *prev = head;
-//
-//    if (head->next) {
-//        head = head->next;
-//    }
-//
-//    free(prev);
+    if (buf == NULL || file == NULL) {
+        perror("Error reading tracefile:");
+        exit(1);
+    }
+    *size = 0;
+    while ((n = fread(buf, 1, HASH_BUFSIZE, file)) > 0) {
+        memset(buf + n, 0, (8 - n % 8) % 8);
+        for (i = 0; i < n; i += 8) {
+            memcpy(&word, buf + i, 8);
+            h = (h ^ word) * 0x100000001b3ULL;
+            h ^= h >> 29;
+        }
+        *size += n;
+    }
+    fclose(file);
+    free(buf);
+    return h ^ *size;
 }
 
-/* Initializes any data structures needed for this
- * replacement algorithm.
+/* Maps the sidecar at path if it matches hdr. Returns 0 on success.
  */
-void opt_init() {
-    char buff[MAXLINE];
+static int load_next_use(const char *path, struct nextuse_header *hdr) {
+    struct nextuse_header *saved;
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd == -1) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(*hdr)) {
+        close(fd);
+        return -1;
+    }
+    map_len = st.st_size;
+    map_addr = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map_addr == MAP_FAILED) {
+        map_addr = NULL;
+        return -1;
+    }
+
+    saved = map_addr;
+    if (memcmp(saved->magic, hdr->magic, sizeof(hdr->magic)) != 0 ||
+        saved->version != hdr->version || saved->flags != hdr->flags ||
+        saved->trace_size != hdr->trace_size ||
+        saved->trace_hash != hdr->trace_hash ||
+        map_len != sizeof(*hdr) + saved->count * sizeof(int64_t)) {
+        munmap(map_addr, map_len);
+        map_addr = NULL;
+        return -1;
+    }
+    num_refs = saved->count;
+    next_use = (const int64_t *)(saved + 1);
+    return 0;
+}
+
+/* Reads the trace and computes the next-use array into a new buffer,
+ * setting num_refs.
+ */
+static int64_t *compute_next_use() {
+    size_t cap = 1 << 16;
+    addr_t *pages = malloc(cap * sizeof(addr_t));
+    int64_t *next, *last, i;
+    unsigned long mask, slot;
+    addr_t vaddr, *keys;
     char type;
-    addr_t vaddr;
-    int line_num = 0;
-    int next_line_num = 0;
-//    head = NULL;
-//    tail = NULL;
-
-    FILE *file = fopen(tracefile, "r");
-    if (!file) {
+    FILE *file = trace_open(tracefile);
+
+    if (file == NULL) {
         perror("Error opening tracefile:");
         exit(1);
     }
+    num_refs = 0;
+    while (read_ref(file, &type, &vaddr)) {
+        if (num_refs == cap) {
+            cap *= 2;
+            pages = realloc(pages, cap * sizeof(addr_t));
+        }
+        if (pages == NULL) {
+            perror("Failed to allocate opt tables");
+            exit(1);
+        }
+        pages[num_refs++] = vaddr >> page_shift;
+    }
+    if (trace_close(file) != 0) {
+        exit(1);
+    }
+    // read_ref's --dedup state and line count must start afresh for the
+    // real replay
+    dedup_page = 1;
+    dedup_dirty = 0;
+    trace_line = 0;
 
-    FILE *positions = fopen(POSITION_FILE, "w");
-    if (!positions) {
-        perror("Error opening POSITION_FILE:");
+    // Hash table from page to the position of its most recent reference
+    // seen so far in the backward pass. Empty slots have a position of -1.
+    for (mask = 1; mask < 2 * num_refs; mask *= 2)
+        ;
+    keys = malloc(mask * sizeof(addr_t));
+    last = malloc(mask * sizeof(int64_t));
+    next = malloc((num_refs ? num_refs : 1) * sizeof(int64_t));
+    if (keys == NULL || last == NULL || next == NULL) {
+        perror("Failed to allocate opt tables");
         exit(1);
     }
+    memset(last, 0xff, mask * sizeof(int64_t));
+    mask--;
 
-    while (fgets(buff, MAXLINE, file)) {
-        if(buff[0] != '=') {
-            sscanf(buff, "%c %lx", &type, &vaddr); // read from buf
-
-            long pos = ftell(file);
-            next_line_num = next_occurrence(vaddr, line_num, file);
-            fseek(file, pos, SEEK_SET); // restore the position
-            line_num++;
-            fprintf(positions, "%d\n", next_line_num);
-            printf("%d", next_line_num);
-//            Node *node = malloc(sizeof(Node));
-//            node->next_pos = next_line_num;
-//            node->next = NULL;
-//
-//            if (!head) { // first node
-//                head = node;
-//            } else {
-//                tail->next = node;
-//            }
-//            tail = node;
+    for (i = (int64_t)num_refs - 1; i >= 0; i--) {
+        slot = (pages[i] * 0x9e3779b97f4a7c15ULL >> 20) & mask;
+        while (last[slot] != -1 && keys[slot] != pages[i]) {
+            slot = (slot + 1) & mask;
         }
+        next[i] = last[slot];
+        keys[slot] = pages[i];
+        last[slot] = i;
     }
-    fclose(positions);
-    fclose(file);
-    printf("done init\n");
+    free(keys);
+    free(last);
+    free(pages);
+    return next;
 }
 
-/**
- *
- * @param vaddr the virtual address to search for
- * @param line_num the current line number of this vaddr
- * @return the line number of next occurrence of this vaddr; -1 if not found
+/* Writes the header and next-use array to a temporary file and renames it
+ * to path. Failure is not fatal; the next run just computes it again.
  */
-int next_occurrence(addr_t vaddr, int line_num, FILE *file) {
-    char buff[MAXLINE];
-    char next_type;
-    addr_t next_vaddr;
-    //int next_line_num = 0;
-
-    while (fgets(buff, MAXLINE, file)) {
-        if (buff[0] != '=') {
-            sscanf(buff, "%c %lx", &next_type, &next_vaddr); // read from buf
-            if (next_vaddr == vaddr) {
-                //fclose(file);
-                return line_num;
-            }
-            line_num++;
-        }
+static void save_next_use(const char *path, struct nextuse_header *hdr,
+                          int64_t *next) {
+    size_t len = strlen(path) + sizeof(".XXXXXX");
+    char *tmp = malloc(len);
+    int fd;
+    FILE *file;
+
+    if (tmp == NULL) {
+        perror("Failed to allocate next-use path");
+        exit(1);
+    }
+    snprintf(tmp, len, "%s.XXXXXX", path);
+    if ((fd = mkstemp(tmp)) == -1 || (file = fdopen(fd, "w")) == NULL) {
+        free(tmp);
+        return;
+    }
+    fchmod(fd, 0644);
+    if (fwrite(hdr, sizeof(*hdr), 1, file) != 1 ||
+        fwrite(next, sizeof(int64_t), hdr->count, file) != hdr->count ||
+        fclose(file) != 0 || rename(tmp, path) != 0) {
+        unlink(tmp);
     }
-    // didn't find the next occurrence
-    //fclose(file);
-    return -1;
+    free(tmp);
 }
+
+/* Initializes any data structures needed for this
+ * replacement algorithm.
+ */
+void opt_init() {
+    struct nextuse_header hdr;
+    char *path;
+    size_t len;
+    int64_t *next;
+
+    if (tracefile == NULL) {
+        fprintf(stderr, "Error: opt needs a tracefile (-f), not stdin\n");
+        exit(1);
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    strcpy(hdr.magic, NEXTUSE_MAGIC);
+    hdr.version = NEXTUSE_VERSION;
+    hdr.flags = (dedup ? NEXTUSE_DEDUP : 0) | page_shift << NEXTUSE_SHIFT;
+    hdr.trace_hash = hash_trace(tracefile, &hdr.trace_size);
+
+    len = strlen(tracefile) + sizeof(".nextuse");
+    if ((path = malloc(len)) == NULL) {
+        perror("Failed to allocate next-use path");
+        exit(1);
+    }
+    snprintf(path, len, "%s.nextuse", tracefile);
+    if (load_next_use(path, &hdr) != 0) {
+        next = compute_next_use();
+        hdr.count = num_refs;
+        save_next_use(path, &hdr, next);
+        next_use = next;
+        if (debug) {
+            printf("computed %s\n", path);
+        }
+    } else if (debug) {
+        printf("loaded %s\n", path);
+    }
+    free(path);
 }
 
+#define REPLAY_FN opt_replay
+#define REPLAY_REF opt_ref
+#define REPLAY_EVICT opt_evict
+#include "replay.h"
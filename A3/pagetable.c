@@ -2,65 +2,245 @@
 #include <string.h> 
 #include "sim.h"
 #include "pagetable.h"
+#include "cost.h"
+#include "window.h"
+#include "tier.h"
+#include "prefetch.h"
+#include "cleaner.h"
+#include "access.h"
 
 // The top-level page table (also known as the 'page directory')
 pgdir_entry_t pgdir[PTRS_PER_PGDIR]; 
 
+// Size of the simulated pages (see pagetable.h)
+unsigned page_shift = PAGE_SHIFT;
+addr_t page_mask = PAGE_MASK;
+
 // Counters for various events.
 // Your code must increment these when the related events occur.
-int hit_count = 0;
-int miss_count = 0;
-int ref_count = 0;
-int evict_clean_count = 0;
-int evict_dirty_count = 0;
+// They are 64 bits wide, so traces can have more than 2^32 references.
+unsigned long hit_count = 0;
+unsigned long miss_count = 0;
+unsigned long ref_count = 0;
+unsigned long evict_clean_count = 0;
+unsigned long evict_dirty_count = 0;
+
+// Modeled service time of the miss being handled (see cost.h)
+static double miss_service_ns = 0;
+
+// Number of 64-bit words in each coremap bitmap, and the first word that
+// may have a free frame. Frames are only freed by resize_coremap(), so the
+// search for a free frame never has to look below it until then.
+static unsigned coremap_words;
+static unsigned free_hint = 0;
+
+static void *coremap_alloc(size_t n, size_t size) {
+	void *p = calloc(n, size);
+	if (p == NULL) {
+		perror("Failed to allocate coremap");
+		exit(1);
+	}
+	return p;
+}
 
 /*
- * Allocates a frame to be used for the virtual page represented by p.
- * If all frames are in use, calls the replacement algorithm's evict_fcn to
- * select a victim frame.  Writes victim to swap if needed, and updates 
- * pagetable entry for victim to indicate that virtual page is no longer in
- * (simulated) physical memory.
+ * Allocates the coremap for nframes frames, all free, with meta_size bytes
+ * of meta data per frame.
+ */
+void init_coremap(unsigned nframes, size_t meta_size) {
+	coremap_words = (nframes + 63) / 64;
+	coremap.in_use = coremap_alloc(coremap_words + 1, sizeof(uint64_t));
+	coremap.referenced = coremap_alloc(coremap_words + 1, sizeof(uint64_t));
+	coremap.dirty = coremap_alloc(coremap_words + 1, sizeof(uint64_t));
+	coremap.pte = coremap_alloc(nframes + 1, sizeof(pgtbl_entry_t *));
+	coremap.meta = coremap_alloc(nframes + 1, meta_size ? meta_size : 1);
+	coremap.meta_size = meta_size;
+
+	// Mark the bits past the last frame in use
+	if (nframes % 64 != 0) {
+		coremap.in_use[coremap_words - 1] = ~(uint64_t)0 << (nframes % 64);
+	}
+}
+
+/*
+ * Moves the page in frame 'from' to the free frame 'to', with its coremap
+ * entry, including the replacement algorithm's meta data.
+ */
+static void move_frame(unsigned from, unsigned to) {
+	pgtbl_entry_t *p = coremap.pte[from];
+
+	if (!fast) {
+		memcpy(&physmem[(size_t)to * frame_bytes],
+		       &physmem[(size_t)from * frame_bytes], frame_bytes);
+	}
+	p->frame = ((unsigned long)to << PAGE_SHIFT) | (p->frame & ~PAGE_MASK);
+	coremap.pte[to] = p;
+	memcpy(frame_meta(to), frame_meta(from), coremap.meta_size);
+	frame_clear(coremap.referenced, to);
+	frame_clear(coremap.dirty, to);
+	if (frame_test(coremap.referenced, from)) {
+		frame_set(coremap.referenced, to);
+	}
+	if (frame_test(coremap.dirty, from)) {
+		frame_set(coremap.dirty, to);
+	}
+	if (prefetching) {
+		prefetch_moved(from, to);
+	}
+	if (on_move_fcn != NULL) {
+		on_move_fcn(from, to);
+	}
+}
+
+/*
+ * Changes the number of frames available to nframes, which is at most the
+ * number init_coremap() allocated, and returns the number of pages evicted.
+ * Frames from memsize on are kept marked in use so that find_free_frame()
+ * does not hand them out.
  *
- * Counters for evictions should be updated appropriately in this function.
+ * Frames are allocated lowest first and only freed here, from the top, so
+ * the frames in use are always 0 up to some frame. When the memory is full,
+ * shrinking it evicts the victim chosen by evict_fcn and moves the page in
+ * the top frame into the victim's frame. The replacement algorithm always
+ * sees a full memory of memsize frames, and an algorithm that keeps its
+ * state per frame in coremap.meta, or follows the moves with its insert
+ * and remove functions, needs no other change.
  */
-int allocate_frame(pgtbl_entry_t *p) {
-	int i;
-	int frame = -1;
-	for(i = 0; i < memsize; i++) {
-		if(!coremap[i].in_use) {
-			frame = i;
-			break;
+unsigned long resize_coremap(unsigned nframes) {
+	unsigned long evicted = 0;
+	unsigned top;
+	int frame;
+
+	while (memsize > nframes) {
+		top = memsize - 1;
+		if (frame_test(coremap.in_use, top) && coremap.pte[top] != NULL) {
+			frame = evict_fcn();
+			evict_frame(frame);
+			evicted++;
+			if ((unsigned)frame != top) {
+				move_frame(top, frame);
+			}
+		}
+		if (on_free_fcn != NULL) {
+			on_free_fcn(top);
 		}
+		frame_set(coremap.in_use, top);
+		frame_clear(coremap.referenced, top);
+		frame_clear(coremap.dirty, top);
+		coremap.pte[top] = NULL;
+		memsize--;
 	}
-	if(frame == -1) { // Didn't find a free page.
-		// Call replacement algorithm's evict function to select victim
-		frame = evict_fcn();
-
-		
-		// 1) get the victim page table entry (pte)
-		pgtbl_entry_t *victim_pte = coremap[frame].pte;
+	if (memsize < nframes && memsize / 64 < free_hint) {
+		free_hint = memsize / 64;
+	}
+	for (; memsize < nframes; memsize++) {
+		frame_clear(coremap.in_use, memsize);
+	}
+	// The writebacks stall the program, but not any one miss
+	if (cost_model) {
+		cost_add(miss_service_ns);
+	}
+	miss_service_ns = 0;
+	return evicted;
+}
 
-		// 2) increase appropriate counter
-		if (victim_pte->frame & PG_DIRTY){
-			evict_dirty_count++;
-		} else {
-			evict_clean_count++;
+/*
+ * Returns the first frame in the coremap that is not in use, or -1 if all
+ * frames are in use.
+ */
+int find_free_frame() {
+	for (; free_hint < coremap_words; free_hint++) {
+		if (coremap.in_use[free_hint] != ~(uint64_t)0) {
+			return free_hint * 64 +
+				__builtin_ctzll(~coremap.in_use[free_hint]);
 		}
-		
-		// 3) write victim pte to swap file
-		int swap_offset = swap_pageout(frame, victim_pte->swap_off);
+	}
+	return -1;
+}
+
+/*
+ * Returns the number of the first memsize frames that hold a page. Frames
+ * are only freed by resize_coremap(), so this is the resident page count.
+ */
+unsigned frames_in_use() {
+	unsigned count = 0, i;
 
-		// 4) update victim pte's status bits (offset in swapfile, valid bit, onswap bit )
-		victim_pte->swap_off = swap_offset;
-		victim_pte->frame &= ~PG_VALID;
-		victim_pte->frame |= PG_ONSWAP;
+	for (i = 0; i < memsize / 64; i++) {
+		count += __builtin_popcountll(coremap.in_use[i]);
+	}
+	if (memsize % 64 != 0) {
+		count += __builtin_popcountll(coremap.in_use[i] &
+					      ~(~(uint64_t)0 << (memsize % 64)));
+	}
+	return count;
+}
+
+/*
+ * Writes the page with pagetable entry victim_pte, stored in (simulated)
+ * physical frame 'frame', to swap and updates the pagetable entry to
+ * indicate that the virtual page is no longer in physical memory.
+ */
+void swap_out_page(pgtbl_entry_t *victim_pte, int frame) {
+	// A clean page whose copy on swap is current is not written; one that
+	// has never been on swap is written even if it is clean
+	off_t swap_offset = victim_pte->swap_off;
+	int write = (victim_pte->frame & PG_DIRTY) || swap_offset == INVALID_SWAP;
+
+	// 1) increase appropriate counter
+	if (victim_pte->frame & PG_DIRTY){
+		evict_dirty_count++;
+	} else {
+		evict_clean_count++;
+	}
+	miss_service_ns += cost_ns[write ? COST_WRITEBACK : COST_CLEAN];
+	
+	// 2) write victim pte to swap file, unless the cleaner already did
+	if (victim_pte->frame & PG_CLEANED) {
+		cleaner_evicted(victim_pte);
+	}
+	if (write) {
+		PROF_START(PROF_SWAPOUT);
+		swap_offset = swap_pageout(frame, swap_offset);
+		PROF_END(PROF_SWAPOUT);
 	}
 
-	// Record information for virtual page that will now be stored in frame
-	coremap[frame].in_use = 1;
-	coremap[frame].pte = p;
+	// 3) update victim pte's status bits (offset in swapfile, valid bit, onswap bit )
+	victim_pte->swap_off = swap_offset;
+	victim_pte->frame &= ~(PG_VALID | PG_FAR);
+	victim_pte->frame |= PG_ONSWAP;
+}
 
-	return frame;
+/*
+ * Evicts the page currently stored in frame, which was chosen as the victim
+ * by the replacement algorithm. Writes victim to swap, or moves it to the
+ * far tier if there is one.
+ */
+void evict_frame(int frame) {
+	if (on_evict_fcn != NULL) {
+		on_evict_fcn(frame, (coremap.pte[frame]->frame & PG_DIRTY) != 0);
+	}
+	if (coremap.pte[frame]->frame & PG_PREFETCH) {
+		prefetch_evicted(coremap.pte[frame]);
+	}
+	if (far_frames) {
+		tier_demote(frame);
+		miss_service_ns += cost_ns[COST_DEMOTE];
+	} else {
+		swap_out_page(coremap.pte[frame], frame);
+	}
+}
+
+/*
+ * Allocates a frame to be used for the virtual page represented by p.
+ * If all frames are in use, calls the replacement algorithm's evict_fcn to
+ * select a victim frame.  Writes victim to swap if needed, and updates 
+ * pagetable entry for victim to indicate that virtual page is no longer in
+ * (simulated) physical memory.
+ *
+ * Counters for evictions should be updated appropriately in this function.
+ */
+int allocate_frame(pgtbl_entry_t *p) {
+	return access_allocate_frame(p, evict_fcn, NULL);
 }
 
 /*
@@ -119,17 +299,62 @@ pgdir_entry_t init_second_level() {
  *
  */
 void init_frame(int frame, addr_t vaddr) {
+	if (fast) {
+		return;
+	}
 	// Calculate pointer to start of frame in (simulated) physical memory
-	char *mem_ptr = &physmem[frame*SIMPAGESIZE];
+	char *mem_ptr = &physmem[(size_t)frame * frame_bytes];
 	// Calculate pointer to location in page where we keep the vaddr
         addr_t *vaddr_ptr = (addr_t *)(mem_ptr + sizeof(int));
 	
-	memset(mem_ptr, 0, SIMPAGESIZE); // zero-fill the frame
+	memset(mem_ptr, 0, frame_bytes); // zero-fill the frame
 	*vaddr_ptr = vaddr;             // record the vaddr for error checking
 
 	return;
 }
 
+/*
+ * Fills the newly allocated frame with the contents of the virtual page
+ * represented by p and records the frame number in p.
+ *
+ * If the entry is not on swap, then this is the first reference to the page
+ * and the frame is initialized (using init_frame). Otherwise the frame is
+ * filled by reading the page data from swap.
+ */
+void load_frame(pgtbl_entry_t *p, int frame, addr_t vaddr) {
+	int promoted = p->frame & PG_FAR;
+
+	if (promoted) { // Promotion from the far tier, not a miss
+		tier_load(p, frame);
+		miss_service_ns += cost_ns[COST_PROMOTE];
+	} else if (!(p->frame & PG_ONSWAP)){ // This is cold miss
+		init_frame(frame, vaddr);
+		miss_service_ns += cost_ns[COST_COLD];
+	} else { // This is capacity miss
+		PROF_START(PROF_SWAPIN);
+		swap_pagein(frame, p->swap_off);
+		PROF_END(PROF_SWAPIN);
+		// The page is clean, and keeps its swap slot, until it is written
+		// again (see pte_set_dirty())
+		p->frame &= ~(PG_ONSWAP | PG_DIRTY);
+		miss_service_ns += cost_ns[COST_SWAPIN];
+	}
+	// Prefetches are read in the background, off the critical path
+	if (cost_model && !(p->frame & PG_PREFETCH)) {
+		if (promoted) {
+			cost_add(miss_service_ns);
+		} else {
+			cost_miss(miss_service_ns);
+		}
+	}
+	miss_service_ns = 0;
+	p->frame = ((unsigned long)frame << PAGE_SHIFT) | (p->frame & ~PAGE_MASK);
+	// A page promoted from the far tier may already be dirty
+	if (p->frame & PG_DIRTY) {
+		frame_set(coremap.dirty, frame);
+	}
+}
+
 /*
  * Locate the physical frame number for the given vaddr using the page table.
  *
@@ -140,71 +365,36 @@ void init_frame(int frame, addr_t vaddr) {
  * If the entry is invalid and on swap, then a (simulated) physical frame
  * should be allocated and filled by reading the page data from swap.
  *
+ * If the entry is in the far tier, the reference is a hit that is either
+ * served there or promotes the page to a newly allocated frame.
+ *
+ * Misses and first references to prefetched pages run the prefetcher,
+ * whose pages are brought in by prefetch_pages() after the reference.
+ *
  * Counters for hit, miss and reference events should be incremented in
  * this function.
+ *
+ * This is the generic version that calls the replacement algorithm through
+ * ref_fcn and evict_fcn; the specialized replay loops in replay.h share
+ * its body, access_physpage() in access.h.
  */
-char *find_physpage(addr_t vaddr, char type) {
-	pgtbl_entry_t *p=NULL; // pointer to the full page table entry for vaddr
-	unsigned idx_pgdir = PGDIR_INDEX(vaddr); // get index into page directory
-
-
-	// IMPLEMENTATION NEEDED
-	// Use top-level page directory to get pointer to 2nd-level page table
-	
-	pgdir_entry_t *pde_t = &pgdir[idx_pgdir];
-
-	// Check if Page Directory Entry is valid. If not, must initialize a new second-level page table.
-	if (!(pde_t->pde & PG_VALID)){ 
-
-		//Initialize a new second-level page table. 
-		*pde_t = init_second_level();
-
-	}
-
-	// Use vaddr to get index into 2nd-level page table and initialize 'p'
-	unsigned idx_pgtbl = PGTBL_INDEX(vaddr);
-	pgtbl_entry_t *table_ptr = (pgtbl_entry_t *)pde_t->pde;
-
-	p = &table_ptr[idx_pgtbl];
-	// Check if p is valid or not, on swap or not, and handle appropriately
-	int frame;
-	
-	if (!(p->frame & PG_VALID) && !(p->frame & PG_ONSWAP)){ // This is cold miss
-		miss_count++;
-		//allocate physical frame and initialize it
-		frame = allocate_frame(p);
-		init_frame(frame, vaddr);
-
-	} else if (!(p->frame & PG_VALID) && (p->frame & PG_ONSWAP)){ // This is capacity miss
-		miss_count++;
-		// allocate physical frame and fill it by the page data from swap
-		frame = allocate_frame(p);
-		swap_pagein(p->frame >> PAGE_SHIFT, p->swap_off);
-		p->frame &= ~PG_ONSWAP;
-
-	} else { // increase hit counter
-		hit_count++;
-
-	}
-
-
-	// Make sure that p is marked valid and referenced. Also mark it
-	// dirty if the access type indicates that the page will be written to.
-	p->frame |= PG_VALID;
-	p->frame |= PG_REF;
-	ref_count++;
-	
-	if (type == 'S' || type == 'M'){
-		p->frame |= PG_DIRTY;
-	}
-
-
-
-	// Call replacement algorithm's ref_fcn for this page
+// Calls the replacement algorithm's ref_fcn for p
+static inline void generic_ref(pgtbl_entry_t *p) {
+	PROF_START(PROF_REF);
 	ref_fcn(p);
+	PROF_END(PROF_REF);
+}
 
-	// Return pointer into (simulated) physical memory at start of frame
-	return  &physmem[(p->frame >> PAGE_SHIFT)*SIMPAGESIZE];
+char *find_physpage(addr_t vaddr, char type) {
+	return access_physpage(vaddr, type, evict_fcn, NULL, generic_ref);
+}
+
+/*
+ * Brings in the pages queued by the prefetcher that are not already in
+ * memory. This is the generic version of access_prefetch_pages().
+ */
+void prefetch_pages() {
+	access_prefetch_pages(evict_fcn, NULL);
 }
 
 void print_pagetbl(pgtbl_entry_t *pgtbl) {
@@ -213,8 +403,7 @@ void print_pagetbl(pgtbl_entry_t *pgtbl) {
 	first_invalid = last_invalid = -1;
 
 	for (i=0; i < PTRS_PER_PGTBL; i++) {
-		if (!(pgtbl[i].frame & PG_VALID) && 
-		    !(pgtbl[i].frame & PG_ONSWAP)) {
+		if (!(pgtbl[i].frame & (PG_VALID | PG_ONSWAP | PG_FAR))) {
 			if (first_invalid == -1) {
 				first_invalid = i;
 			}
@@ -231,10 +420,17 @@ void print_pagetbl(pgtbl_entry_t *pgtbl) {
 				if (pgtbl[i].frame & PG_DIRTY) {
 					printf("DIRTY, ");
 				}
-				printf("in frame %d\n",pgtbl[i].frame >> PAGE_SHIFT);
+				printf("in frame %lu\n",pgtbl[i].frame >> PAGE_SHIFT);
+			} else if (pgtbl[i].frame & PG_FAR) {
+				printf("FAR, ");
+				if (pgtbl[i].frame & PG_DIRTY) {
+					printf("DIRTY, ");
+				}
+				printf("in frame %lu\n",pgtbl[i].frame >> PAGE_SHIFT);
 			} else {
 				assert(pgtbl[i].frame & PG_ONSWAP);
-				printf("ONSWAP, at offset %lu\n",pgtbl[i].swap_off);
+				printf("ONSWAP, at offset %lld\n",
+				       (long long)pgtbl[i].swap_off);
 			}			
 		}
 	}
@@ -269,3 +465,47 @@ void print_pagedirectory() {
 		}
 	}
 }
+
+/*
+ * Counts the resident (in either memory tier) and swapped pages in the page
+ * table for page directory entry i. Returns 0 if the entry is not valid.
+ */
+int count_pagetbl(int i, unsigned *resident, unsigned *swapped) {
+	pgtbl_entry_t *pgtbl;
+	int j;
+
+	*resident = *swapped = 0;
+	if (!(pgdir[i].pde & PG_VALID)) {
+		return 0;
+	}
+	pgtbl = (pgtbl_entry_t *)(pgdir[i].pde & PAGE_MASK);
+	for (j = 0; j < PTRS_PER_PGTBL; j++) {
+		if (pgtbl[j].frame & (PG_VALID | PG_FAR)) {
+			(*resident)++;
+		} else if (pgtbl[j].frame & PG_ONSWAP) {
+			(*swapped)++;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Prints the number of resident and swapped pages under each valid page
+ * directory entry, one line per entry, instead of every page table entry.
+ */
+void print_pagedirectory_summary() {
+	unsigned resident, swapped, total_resident = 0, total_swapped = 0;
+	int i;
+
+	printf("%-8s %10s %10s\n", "pgdir", "resident", "swapped");
+	for (i = 0; i < PTRS_PER_PGDIR; i++) {
+		if (count_pagetbl(i, &resident, &swapped)) {
+			char label[16];
+			snprintf(label, sizeof(label), "[%d]", i);
+			printf("%-8s %10u %10u\n", label, resident, swapped);
+			total_resident += resident;
+			total_swapped += swapped;
+		}
+	}
+	printf("%-8s %10u %10u\n", "total", total_resident, total_swapped);
+}
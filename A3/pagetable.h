@@ -10,10 +10,20 @@
 #define PAGE_SHIFT      12     // number of bits 2^(PAGE_SHIFT) == PAGE_SIZE
 #define PAGE_SIZE       4096 // Size of pagetable pages
 #define PAGE_MASK       (~(PAGE_SIZE-1))
+                             // The status bits below fit under PAGE_MASK,
+                             // in pdes and in the frame field of ptes
 #define PG_VALID        (0x1) // Valid bit in pgd or pte, set if in memory
 #define PG_DIRTY        (0x2) // Dirty bit in pgd or pte, set if modified
 #define PG_REF          (0x4) // Reference bit, set if page has been referenced
 #define PG_ONSWAP       (0x8) // Set if page has been evicted to swap
+#define PG_WINDOW       (0x10) // Set if page was referenced in the current
+                               // statistics window (see window.c)
+#define PG_FAR          (0x20) // Set if page is in the far memory tier
+                               // (see tier.h)
+#define PG_PREFETCH     (0x40) // Set if page was prefetched and has not been
+                               // referenced since (see prefetch.h)
+#define PG_CLEANED      (0x80) // Set if page was written back by the cleaner
+                               // and has a current copy on swap (cleaner.h)
 #define INVALID_SWAP    -1
 
 #ifdef TRACE_64
@@ -36,12 +46,19 @@
 
 #endif
 
-#define PGTBL_MASK        (PTRS_PER_PGTBL-1)
-#define PGDIR_INDEX(x)   ((x) >> PGDIR_SHIFT)
-#define PGTBL_INDEX(x)   (((x) >> PAGE_SHIFT) & PGTBL_MASK)
+typedef unsigned long addr_t;
 
+// The simulated virtual pages can be larger than PAGE_SIZE (sim -p). Their
+// size is a power of two, page_shift is its log2 and page_mask clears the
+// offset within a page, so translation is still just shifts and masks.
+// A larger page moves the page directory and page table indices up by the
+// same number of bits.
+extern unsigned page_shift;
+extern addr_t page_mask;
 
-typedef unsigned long addr_t;
+#define PGTBL_MASK        (PTRS_PER_PGTBL-1)
+#define PGDIR_INDEX(x)   ((x) >> (PGDIR_SHIFT - PAGE_SHIFT + page_shift))
+#define PGTBL_INDEX(x)   (((x) >> page_shift) & PGTBL_MASK)
 
 // These defines allow us to take advantage of the compiler's typechecking
 
@@ -52,33 +69,88 @@ typedef struct {
 
 // Page table entry (2nd-level). 
 typedef struct { 
-	unsigned int frame; // if valid bit == 1, physical frame holding vpage
+	unsigned long frame; // if valid bit == 1, physical frame holding vpage
 	off_t swap_off;       // offset in swap file of vpage, if any
 } pgtbl_entry_t;    
 
 extern void init_pagetable();
 extern char *find_physpage(addr_t vaddr, char type);
+extern int allocate_frame(pgtbl_entry_t *p);
+
+// Pieces of find_physpage() shared with the specialized replay loops
+// (see replay.h).
+extern pgdir_entry_t pgdir[PTRS_PER_PGDIR];
+extern pgdir_entry_t init_second_level();
+extern int find_free_frame(void);
+extern void evict_frame(int frame);
+extern void swap_out_page(pgtbl_entry_t *p, int frame);
+extern void load_frame(pgtbl_entry_t *p, int frame, addr_t vaddr);
+extern void prefetch_pages(void);
+extern unsigned long resize_coremap(unsigned nframes);
+extern unsigned frames_in_use(void);
 
 extern void print_pagedirectory(void);
-
-struct frame {
-	char in_use;       // True if frame is allocated, False if frame is free
-	pgtbl_entry_t *pte;// Pointer back to pagetable entry (pte) for page
-	                   // stored in this frame
+extern int count_pagetbl(int i, unsigned *resident, unsigned *swapped);
+extern void print_pagedirectory_summary(void);
+
+/* The coremap holds information about physical memory, as parallel arrays
+ * indexed by the physical page frame number stored in the page table entry
+ * (pgtbl_entry_t). Keeping each field in its own dense array means that an
+ * algorithm scanning one field of every frame reads contiguous memory.
+ * The flags are bitmaps with one bit per frame (see frame_test()).
+ */
+struct coremap {
+	uint64_t *in_use;     // Set if frame is allocated
+	uint64_t *referenced; // Set when the page in the frame is referenced
+	uint64_t *dirty;      // Set when the page in the frame is written
+	pgtbl_entry_t **pte;  // Pointer back to pagetable entry (pte) for page
+	                      // stored in this frame
+	char *meta;           // meta_size bytes per frame for the replacement
+	                      // algorithm, e.g. the next reference for opt
+	size_t meta_size;
 };
 
-/* The coremap holds information about physical memory.
- * The index into coremap is the physical page frame number stored
- * in the page table entry (pgtbl_entry_t).
- */
-extern struct frame *coremap;
+extern struct coremap coremap;
+extern void init_coremap(unsigned nframes, size_t meta_size);
+
+// Returns the replacement algorithm's meta data for frame
+static inline void *frame_meta(unsigned frame) {
+	return coremap.meta + (size_t)frame * coremap.meta_size;
+}
+
+static inline int frame_test(uint64_t *map, unsigned frame) {
+	return (map[frame >> 6] >> (frame & 63)) & 1;
+}
+
+static inline void frame_set(uint64_t *map, unsigned frame) {
+	map[frame >> 6] |= (uint64_t)1 << (frame & 63);
+}
+
+static inline void frame_clear(uint64_t *map, unsigned frame) {
+	map[frame >> 6] &= ~((uint64_t)1 << (frame & 63));
+}
 
 
 // Swap functions for use in other files
 extern int swap_init(unsigned swapsize);
 extern void swap_destroy(void);
-extern int swap_pagein(unsigned frame, int swap_offset);
-extern int swap_pageout(unsigned frame, int swap_offset);
+extern int swap_pagein(unsigned frame, off_t swap_offset);
+extern off_t swap_pageout(unsigned frame, off_t swap_offset);
+extern unsigned swap_slots_used(void);
+extern unsigned swap_slots_peak(void);
+extern void swap_free(off_t swap_offset);
+extern unsigned long swap_writes(void);
+
+/* Marks the page p dirty. Its copy on swap, if it has one, is out of date
+ * from now on, so the slot is freed for reuse.
+ */
+static inline void pte_set_dirty(pgtbl_entry_t *p) {
+	if (!(p->frame & PG_DIRTY) && p->swap_off != INVALID_SWAP) {
+		swap_free(p->swap_off);
+		p->swap_off = INVALID_SWAP;
+	}
+	p->frame |= PG_DIRTY;
+}
 
 extern void rand_init();
 extern void lru_init();
@@ -87,16 +159,58 @@ extern void fifo_init();
 extern void opt_init();
 
 // These may not need to do anything for some algorithms
-extern void rand_ref(pgtbl_entry_t *);
 extern void lru_ref(pgtbl_entry_t *);
-extern void clock_ref(pgtbl_entry_t *);
-extern void fifo_ref(pgtbl_entry_t *);
 extern void opt_ref(pgtbl_entry_t *);
 
+// Batched version of ref for algorithms that don't need to see every
+// reference as it happens.
+extern void rand_ref_batch(pgtbl_entry_t **, int);
+extern void clock_ref_batch(pgtbl_entry_t **, int);
+extern void fifo_ref_batch(pgtbl_entry_t **, int);
+
 extern int rand_evict();
 extern int lru_evict();
 extern int clock_evict();
 extern int fifo_evict();
 extern int opt_evict();
+extern int opt_victims(int *, int);
+extern int lru_victims(int *, int);
+extern int fifo_victims(int *, int);
+
+// Frame events for the algorithms that keep their own order of the
+// resident pages (see policy.h)
+extern void lru_on_insert(int, addr_t, char);
+extern void lru_on_evict(int, int);
+extern void lru_on_move(int, int);
+extern void lru_on_free(int);
+extern void fifo_on_insert(int, addr_t, char);
+extern void fifo_on_evict(int, int);
+extern void fifo_on_move(int, int);
+extern void fifo_on_free(int);
+extern void lru_destroy();
+extern void fifo_destroy();
+
+// Replay loops specialized for each algorithm (see replay.h)
+extern void rand_replay(FILE *);
+extern void lru_replay(FILE *);
+extern void clock_replay(FILE *);
+extern void fifo_replay(FILE *);
+extern void opt_replay(FILE *);
+
+/* Returns the page table entry for vaddr, using the top-level page
+ * directory to find the 2nd-level page table. The 2nd-level page table is
+ * allocated the first time any address it covers is referenced.
+ */
+static inline pgtbl_entry_t *lookup_pte(addr_t vaddr) {
+	pgdir_entry_t *pde = &pgdir[PGDIR_INDEX(vaddr)];
+	pgtbl_entry_t *pgtbl;
+
+	if (!(pde->pde & PG_VALID)) {
+		*pde = init_second_level();
+	}
+	pgtbl = (pgtbl_entry_t *)(pde->pde & PAGE_MASK);
+
+	return &pgtbl[PGTBL_INDEX(vaddr)];
+}
 
 #endif /* PAGETABLE_H */
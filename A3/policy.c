@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include "sim.h"
+#include "pagetable.h"
+#include "policy.h"
+
+#define PLUGIN_PREFIX "plugin:"
+
+/* The algs array gives us a mapping between the name of an eviction
+ * algorithm as given in a command line argument, and the functions to
+ * call to select the victim page.
+ */
+static struct policy algs[] = {
+	{.abi_version = POLICY_ABI_VERSION, .name = "rand",
+	 .init = rand_init, .ref_batch = rand_ref_batch, .evict = rand_evict,
+	 .replay = rand_replay},
+	{.abi_version = POLICY_ABI_VERSION, .name = "lru",
+	 .init = lru_init, .ref = lru_ref, .evict = lru_evict,
+	 .destroy = lru_destroy, .victims = lru_victims, .replay = lru_replay,
+	 .on_insert = lru_on_insert, .on_evict = lru_on_evict,
+	 .on_move = lru_on_move, .on_free = lru_on_free},
+	{.abi_version = POLICY_ABI_VERSION, .name = "fifo",
+	 .init = fifo_init, .ref_batch = fifo_ref_batch, .evict = fifo_evict,
+	 .destroy = fifo_destroy, .victims = fifo_victims, .replay = fifo_replay,
+	 .on_insert = fifo_on_insert, .on_evict = fifo_on_evict,
+	 .on_move = fifo_on_move, .on_free = fifo_on_free},
+	{.abi_version = POLICY_ABI_VERSION, .name = "clock",
+	 .init = clock_init, .ref_batch = clock_ref_batch, .evict = clock_evict,
+	 .replay = clock_replay},
+	{.abi_version = POLICY_ABI_VERSION, .name = "opt", .meta_size = sizeof(long),
+	 .init = opt_init, .ref = opt_ref, .evict = opt_evict,
+	 .victims = opt_victims, .replay = opt_replay}
+};
+static int num_algs = sizeof(algs) / sizeof(algs[0]);
+
+// Loads the policy plugin in the shared library at path
+static struct policy *load_plugin(char *path) {
+	struct policy *policy;
+	void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+
+	if (handle == NULL) {
+		fprintf(stderr, "Error: %s\n", dlerror());
+		exit(1);
+	}
+	if ((policy = dlsym(handle, POLICY_SYMBOL)) == NULL) {
+		fprintf(stderr, "Error: %s does not define %s\n", path, POLICY_SYMBOL);
+		exit(1);
+	}
+	if (policy->abi_version != POLICY_ABI_VERSION) {
+		fprintf(stderr, "Error: %s has policy ABI version %u, sim has %u\n",
+			path, policy->abi_version, POLICY_ABI_VERSION);
+		exit(1);
+	}
+	if (policy->evict == NULL || (policy->ref == NULL) == (policy->ref_batch == NULL)) {
+		fprintf(stderr, "Error: %s must define evict and one of ref and "
+			"ref_batch\n", path);
+		exit(1);
+	}
+	if (policy->name == NULL) {
+		policy->name = path;
+	}
+	return policy;
+}
+
+/* Returns the built-in policy called name, or the plugin policy loaded
+ * from path if name is plugin:path. Returns NULL if there is no built-in
+ * policy called name.
+ */
+struct policy *policy_find(char *name) {
+	int i;
+
+	if (strncmp(name, PLUGIN_PREFIX, strlen(PLUGIN_PREFIX)) == 0) {
+		return load_plugin(name + strlen(PLUGIN_PREFIX));
+	}
+	for (i = 0; i < num_algs; i++) {
+		if (strcmp(algs[i].name, name) == 0) {
+			return &algs[i];
+		}
+	}
+	return NULL;
+}
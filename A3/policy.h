@@ -0,0 +1,63 @@
+#ifndef __POLICY_H__
+#define __POLICY_H__
+
+#include <stdio.h>
+#include "pagetable.h"
+
+/* Replacement policy ABI.
+ *
+ * Each replacement algorithm is a struct policy. The built-in algorithms
+ * are listed in policy.c, and sim -a plugin:path loads one from a shared
+ * library that defines a struct policy named sim_policy (see
+ * policy_example.c). sim exports its symbols, so a plugin can use the
+ * coremap, memsize and the counters declared in sim.h and pagetable.h.
+ *
+ * abi_version must be POLICY_ABI_VERSION; a plugin built against another
+ * version of this header is refused. meta_size bytes of coremap.meta are
+ * kept per frame for the policy (see frame_meta()). They are zeroed when a
+ * new page is placed in the frame, and move with the page when
+ * resize_coremap() moves it to another frame. A policy provides evict and
+ * either ref or ref_batch; the other functions may be NULL.
+ *
+ * Besides ref, which is called on every reference, a policy can follow
+ * what happens to each frame through events, which pass frame numbers:
+ *   on_insert(frame, vpage, type)  a page, with virtual page number vpage,
+ *                                  has been loaded into frame on a miss of
+ *                                  the given reference type, or 'P' if it
+ *                                  was prefetched (see prefetch.h)
+ *   on_hit(frame, type)            a reference hit the page in frame
+ *   on_evict(frame, dirty)         the page in frame, chosen by evict, is
+ *                                  being evicted; the frame is reused next
+ *   on_move(from, to)              resize_coremap() moved the page in from
+ *                                  to the free frame to
+ *   on_free(frame)                 resize_coremap() took frame away; it is
+ *                                  not used until the memory grows again
+ * A page's on_insert comes before the ref call for its reference.
+ */
+
+#define POLICY_ABI_VERSION  2
+#define POLICY_SYMBOL       "sim_policy"
+
+struct policy {
+	unsigned abi_version;        // POLICY_ABI_VERSION
+	const char *name;            // String name of eviction algorithm
+	size_t meta_size;            // Bytes of coremap.meta per frame
+	void (*init)(void);          // Initialize any data needed by alg
+	void (*ref)(pgtbl_entry_t *);    // Called on each reference
+	void (*ref_batch)(pgtbl_entry_t **, int); // Called on batches of refs
+	int (*evict)(void);          // Called to choose victim for eviction
+	void (*destroy)(void);       // Called at the end of the run
+	int (*victims)(int *, int);  // The frames evict would choose next, in
+	                             // order (see cleaner.h)
+	void (*replay)(FILE *);      // Replays the whole trace (see replay.h);
+	                             // if NULL, replay_trace() is used
+	void (*on_insert)(int frame, addr_t vpage, char type);
+	void (*on_hit)(int frame, char type);
+	void (*on_evict)(int frame, int dirty);
+	void (*on_move)(int from, int to);
+	void (*on_free)(int frame);
+};
+
+extern struct policy *policy_find(char *name);
+
+#endif /* __POLICY_H__ */
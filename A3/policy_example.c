@@ -0,0 +1,45 @@
+#include <limits.h>
+#include "sim.h"
+#include "pagetable.h"
+#include "policy.h"
+
+/* An example replacement policy plugin, FIFO, built into
+ * libpolicy_example.so by make and loaded with
+ *   sim -a plugin:./libpolicy_example.so ...
+ * Each frame's meta data holds the order in which its page came in, set
+ * by the on_insert event. It moves with the page if resize_coremap()
+ * moves it, so the policy needs no on_move.
+ */
+
+static unsigned long num_inserted = 0;
+
+// Evicts the page that came in first
+static int example_evict() {
+	unsigned long oldest = ULONG_MAX, *order;
+	int i, frame = 0;
+
+	for (i = 0; i < memsize; i++) {
+		order = frame_meta(i);
+		if (*order < oldest) {
+			oldest = *order;
+			frame = i;
+		}
+	}
+	return frame;
+}
+
+static void example_ref(pgtbl_entry_t *p) {
+}
+
+static void example_on_insert(int frame, addr_t vpage, char type) {
+	*(unsigned long *)frame_meta(frame) = ++num_inserted;
+}
+
+struct policy sim_policy = {
+	.abi_version = POLICY_ABI_VERSION,
+	.name = "example-fifo",
+	.meta_size = sizeof(unsigned long),
+	.ref = example_ref,
+	.evict = example_evict,
+	.on_insert = example_on_insert,
+};
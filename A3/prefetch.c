@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "pagetable.h"
+#include "prefetch.h"
+
+#define MAX_DEGREE      64
+#define MARKOV_BITS     16     // log2 of the number of markov table entries
+#define MARKOV_WAYS     4      // successors kept per page, most recent first
+
+enum { PF_SEQ, PF_STRIDE, PF_MARKOV };
+static const char *prefetch_names[] = {"seq", "stride", "markov"};
+
+int prefetching = 0;
+static int kind;
+static int degree;
+
+// Pages queued to be brought in once the current reference is complete
+static addr_t queue[MAX_DEGREE];
+static int queue_len = 0, queue_pos = 0;
+
+// Last page that triggered the prefetcher, and for stride the last stride
+static addr_t last_page;
+static long last_stride = 0;
+static int have_last = 0;
+
+// Direct-mapped table from a page to the pages that triggered the
+// prefetcher right after it
+struct markov_entry {
+	addr_t page;
+	addr_t next[MARKOV_WAYS];
+	int count;
+};
+static struct markov_entry *markov;
+
+// Reference count when the page in each frame was prefetched
+static unsigned long *prefetch_time;
+
+unsigned long prefetch_issued = 0;
+static unsigned long prefetch_used = 0;
+static unsigned long prefetch_polluted = 0;
+static unsigned long lead_total = 0;
+static unsigned long lead_max = 0;
+
+/* Selects the prefetcher by name, bringing in up to degree pages at a time.
+ * Returns -1 if the name or degree is not valid.
+ */
+int prefetch_init(char *name, int d) {
+	for (kind = PF_MARKOV; kind >= 0; kind--) {
+		if (strcmp(name, prefetch_names[kind]) == 0) {
+			break;
+		}
+	}
+	if (kind < 0 || d < 1 || d > MAX_DEGREE) {
+		return -1;
+	}
+	degree = d;
+	if (kind == PF_MARKOV) {
+		markov = calloc(1 << MARKOV_BITS, sizeof(struct markov_entry));
+	}
+	prefetch_time = calloc(memsize, sizeof(unsigned long));
+	if ((kind == PF_MARKOV && markov == NULL) || prefetch_time == NULL) {
+		perror("Failed to allocate prefetcher");
+		exit(1);
+	}
+	prefetching = 1;
+	return 0;
+}
+
+// Queues page to be prefetched, unless it is past the end of the address space
+static inline void enqueue(addr_t page) {
+	if (queue_len < degree &&
+	    page < (addr_t)PTRS_PER_PGDIR * PTRS_PER_PGTBL) {
+		queue[queue_len++] = page;
+	}
+}
+
+static inline struct markov_entry *markov_entry(addr_t page) {
+	return &markov[(page * 0x9e3779b97f4a7c15ULL) >> (64 - MARKOV_BITS)];
+}
+
+// Records page as the most recent successor of prev
+static void markov_train(addr_t prev, addr_t page) {
+	struct markov_entry *e = markov_entry(prev);
+	int i;
+
+	if (e->page != prev || e->count == 0) {
+		e->page = prev;
+		e->count = 0;
+	}
+	for (i = 0; i < e->count && e->next[i] != page; i++)
+		;
+	if (i == e->count) { // new successor, replacing the oldest if full
+		if (e->count < MARKOV_WAYS) {
+			e->count++;
+		}
+		i = e->count - 1;
+	}
+	for (; i > 0; i--) {
+		e->next[i] = e->next[i - 1];
+	}
+	e->next[0] = page;
+}
+
+/* Runs the prefetcher on a reference to vaddr that missed or was the first
+ * to a prefetched page, queueing the pages it predicts.
+ */
+void prefetch_miss(addr_t vaddr) {
+	addr_t page = vaddr >> page_shift;
+	struct markov_entry *e;
+	long stride;
+	int i;
+
+	queue_len = queue_pos = 0;
+	switch (kind) {
+	case PF_SEQ:
+		for (i = 1; i <= degree; i++) {
+			enqueue(page + i);
+		}
+		break;
+	case PF_STRIDE:
+		stride = have_last ? (long)(page - last_page) : 0;
+		if (stride != 0 && stride == last_stride) {
+			for (i = 1; i <= degree; i++) {
+				enqueue(page + i * stride);
+			}
+		}
+		last_stride = stride;
+		break;
+	case PF_MARKOV:
+		if (have_last && last_page != page) {
+			markov_train(last_page, page);
+		}
+		e = markov_entry(page);
+		if (e->page == page) {
+			for (i = 0; i < e->count; i++) {
+				enqueue(e->next[i]);
+			}
+		}
+		break;
+	}
+	last_page = page;
+	have_last = 1;
+}
+
+/* Counts the first reference to the prefetched page p as a use of the
+ * prefetch, and runs the prefetcher again.
+ */
+void prefetch_hit(pgtbl_entry_t *p, addr_t vaddr) {
+	unsigned long lead = ref_count - prefetch_time[p->frame >> PAGE_SHIFT];
+
+	p->frame &= ~PG_PREFETCH;
+	prefetch_used++;
+	lead_total += lead;
+	if (lead > lead_max) {
+		lead_max = lead;
+	}
+	prefetch_miss(vaddr);
+}
+
+/* Returns the next queued page to prefetch in *vaddr, or 0 if there is none.
+ */
+int prefetch_next(addr_t *vaddr) {
+	if (queue_pos == queue_len) {
+		return 0;
+	}
+	*vaddr = queue[queue_pos++] << page_shift;
+	return 1;
+}
+
+/* Records that the page p has just been prefetched.
+ */
+void prefetch_loaded(pgtbl_entry_t *p) {
+	prefetch_time[p->frame >> PAGE_SHIFT] = ref_count;
+	prefetch_issued++;
+}
+
+/* Counts the prefetched page p, being evicted before it was ever referenced,
+ * as pollution.
+ */
+void prefetch_evicted(pgtbl_entry_t *p) {
+	p->frame &= ~PG_PREFETCH;
+	prefetch_polluted++;
+}
+
+/* Moves the prefetch time of the page in frame from, which has been moved
+ * to frame to (see resize_coremap()).
+ */
+void prefetch_moved(int from, int to) {
+	prefetch_time[to] = prefetch_time[from];
+}
+
+void prefetch_report(FILE *fp) {
+	fprintf(fp, "\nPrefetcher: %s, degree %d\n", prefetch_names[kind], degree);
+	fprintf(fp, "Pages prefetched: %lu\n", prefetch_issued);
+	fprintf(fp, "Prefetched pages used: %lu\n", prefetch_used);
+	fprintf(fp, "Prefetched pages evicted unused: %lu\n", prefetch_polluted);
+	fprintf(fp, "Accuracy (used / prefetched): %.4f\n", prefetch_issued ?
+		(double)prefetch_used / prefetch_issued : 0.0);
+	fprintf(fp, "Coverage (used / (used + misses)): %.4f\n",
+		prefetch_used + miss_count ?
+		(double)prefetch_used / (prefetch_used + miss_count) : 0.0);
+	fprintf(fp, "Pollution (evicted unused / prefetched): %.4f\n",
+		prefetch_issued ? (double)prefetch_polluted / prefetch_issued : 0.0);
+	fprintf(fp, "Prefetch lead in references: mean %.1f, max %lu\n",
+		prefetch_used ? (double)lead_total / prefetch_used : 0.0, lead_max);
+}
@@ -0,0 +1,42 @@
+#ifndef __PREFETCH_H__
+#define __PREFETCH_H__
+
+#include <stdio.h>
+#include "pagetable.h"
+
+/* Prefetching, enabled with sim --prefetch seq|stride|markov.
+ *
+ * The prefetcher is called on each miss and on the first reference to
+ * each prefetched page, and queues up to --prefetch-degree D pages to
+ * bring in:
+ *   seq     the D pages after the referenced one
+ *   stride  D pages further along the stride between the last misses,
+ *           once the same stride has been seen twice in a row
+ *   markov  up to D pages that missed right after the previous misses
+ *           of the referenced page
+ *
+ * The queue is issued once the reference that filled it is complete,
+ * so its check_mem() sees the page. A prefetch into a full memory
+ * evicts whatever the replacement algorithm chooses, which may be the
+ * page that was just referenced: evict cannot be asked for a victim
+ * without taking it, since policies update their state when it is
+ * called. With a single frame that is always the case, so nothing is
+ * prefetched then. Pages that are already in memory are skipped. A prefetched page is loaded
+ * like a miss, without counting as one, and has PG_PREFETCH set until
+ * it is first referenced. The replacement algorithm sees it from then
+ * on, like any other page.
+ */
+
+extern int prefetching;
+extern unsigned long prefetch_issued;
+
+extern int prefetch_init(char *name, int degree);
+extern void prefetch_miss(addr_t vaddr);
+extern void prefetch_hit(pgtbl_entry_t *p, addr_t vaddr);
+extern int prefetch_next(addr_t *vaddr);
+extern void prefetch_loaded(pgtbl_entry_t *p);
+extern void prefetch_evicted(pgtbl_entry_t *p);
+extern void prefetch_moved(int from, int to);
+extern void prefetch_report(FILE *fp);
+
+#endif /* __PREFETCH_H__ */
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "profile.h"
+
+#define PROF_MAX_DEPTH 16
+
+int profiling = 0;
+
+static const char *phase_names[NUM_PROF_PHASES] = {
+	"parse", "walk", "alloc", "evict", "swapin", "swapout", "ref", "verify",
+	"decompress"
+};
+
+// Per-thread profile. Threads add theirs to a global list the first time
+// they record anything, and the lists are only read by profile_report().
+struct thread_profile {
+	char name[32];
+	uint64_t self[NUM_PROF_PHASES];    // time excluding nested phases
+	uint64_t total[NUM_PROF_PHASES];   // time including nested phases
+	uint64_t calls[NUM_PROF_PHASES];
+
+	// Stack of phases that are currently open
+	uint64_t start[PROF_MAX_DEPTH];
+	uint64_t child[PROF_MAX_DEPTH];    // time spent in nested phases
+	enum prof_phase phase[PROF_MAX_DEPTH];
+	int depth;
+
+	struct thread_profile *next;
+};
+
+static __thread struct thread_profile *my_prof = NULL;
+static struct thread_profile *all_profs = NULL;
+static int num_profs = 0;
+static pthread_mutex_t profs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Wall clock and tick count at profile_init(), used to convert ticks to ns
+static struct timespec start_ts;
+static uint64_t start_ticks;
+
+static inline uint64_t now_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static struct thread_profile *get_prof() {
+	if (my_prof == NULL) {
+		if ((my_prof = calloc(1, sizeof(struct thread_profile))) == NULL) {
+			perror("Failed to allocate profile");
+			exit(1);
+		}
+		pthread_mutex_lock(&profs_lock);
+		snprintf(my_prof->name, sizeof(my_prof->name), "thread %d",
+			 num_profs++);
+		my_prof->next = all_profs;
+		all_profs = my_prof;
+		pthread_mutex_unlock(&profs_lock);
+	}
+	return my_prof;
+}
+
+void prof_thread_name(const char *name) {
+	struct thread_profile *prof = get_prof();
+	strncpy(prof->name, name, sizeof(prof->name) - 1);
+}
+
+void prof_start(enum prof_phase phase) {
+	struct thread_profile *prof = get_prof();
+	int d = prof->depth++;
+
+	if (d >= PROF_MAX_DEPTH) {
+		fprintf(stderr, "prof_start: phases nested too deeply\n");
+		exit(1);
+	}
+	prof->phase[d] = phase;
+	prof->child[d] = 0;
+	prof->start[d] = now_ticks();
+}
+
+void prof_end(enum prof_phase phase) {
+	uint64_t end = now_ticks();
+	struct thread_profile *prof = get_prof();
+	int d = --prof->depth;
+	uint64_t elapsed;
+
+	// Every PROF_END must close the most recent PROF_START
+	if (d < 0 || prof->phase[d] != phase) {
+		fprintf(stderr, "prof_end: %s does not match open phase %s\n",
+			phase_names[phase],
+			d < 0 ? "(none)" : phase_names[prof->phase[d]]);
+		exit(1);
+	}
+	elapsed = end - prof->start[d];
+
+	prof->total[phase] += elapsed;
+	prof->self[phase] += elapsed - prof->child[d];
+	prof->calls[phase]++;
+	if (d > 0) {
+		prof->child[d-1] += elapsed;
+	}
+}
+
+void profile_init() {
+	profiling = 1;
+	clock_gettime(CLOCK_MONOTONIC, &start_ts);
+	start_ticks = now_ticks();
+	prof_thread_name("main");
+}
+
+/* Prints one table per thread with the time spent in each phase. The
+ * percentages are of the wall clock time since profile_init().
+ */
+void profile_report(FILE *fp) {
+	struct timespec end_ts;
+	uint64_t end_ticks = now_ticks();
+	double wall_ns, ns_per_tick;
+	struct thread_profile *prof;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &end_ts);
+	wall_ns = (end_ts.tv_sec - start_ts.tv_sec) * 1e9 +
+		(end_ts.tv_nsec - start_ts.tv_nsec);
+	ns_per_tick = end_ticks > start_ticks ?
+		wall_ns / (end_ticks - start_ticks) : 1.0;
+
+	fprintf(fp, "\nProfile (wall time %.3f ms)\n", wall_ns / 1e6);
+	for (prof = all_profs; prof != NULL; prof = prof->next) {
+		double profiled = 0;
+
+		fprintf(fp, "%s:\n", prof->name);
+		fprintf(fp, "  %-8s %12s %12s %12s %10s %7s\n", "phase",
+			"calls", "self ms", "total ms", "avg ns", "self %");
+		for (i = 0; i < NUM_PROF_PHASES; i++) {
+			double self_ns = prof->self[i] * ns_per_tick;
+			double total_ns = prof->total[i] * ns_per_tick;
+
+			if (prof->calls[i] == 0) {
+				continue;
+			}
+			profiled += self_ns;
+			fprintf(fp, "  %-8s %12llu %12.3f %12.3f %10.1f %7.2f\n",
+				phase_names[i],
+				(unsigned long long)prof->calls[i],
+				self_ns / 1e6, total_ns / 1e6,
+				total_ns / prof->calls[i],
+				self_ns / wall_ns * 100);
+		}
+		fprintf(fp, "  %-8s %12s %12.3f %12s %10s %7.2f\n", "(sum)", "",
+			profiled / 1e6, "", "", profiled / wall_ns * 100);
+	}
+}
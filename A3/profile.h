@@ -0,0 +1,44 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Hot-path profiler, enabled with sim --profile.
+ *
+ * Each phase of the simulation is bracketed by PROF_START/PROF_END. When
+ * profiling is off, each bracket costs one test of a global flag. When it
+ * is on, timestamps are taken with rdtsc (or clock_gettime where rdtsc is
+ * not available) and accumulated per thread. Phases may nest; the time
+ * spent in a nested phase is charged to it and not to its parent, so the
+ * "self" times add up to the profiled total. Each PROF_END must name the
+ * phase of the innermost open PROF_START; a mismatch is a fatal error.
+ */
+
+enum prof_phase {
+	PROF_PARSE,      // reading and parsing trace lines
+	PROF_WALK,       // page table walk
+	PROF_ALLOC,      // allocate_frame, excluding eviction and swap
+	PROF_EVICT,      // victim selection by the replacement algorithm
+	PROF_SWAPIN,     // swap_pagein
+	PROF_SWAPOUT,    // swap_pageout
+	PROF_REF,        // replacement algorithm's ref function
+	PROF_VERIFY,     // access_mem content check
+	PROF_DECOMPRESS, // decompressing the trace (see traceio.c)
+	NUM_PROF_PHASES
+};
+
+extern int profiling;
+
+extern void prof_start(enum prof_phase phase);
+extern void prof_end(enum prof_phase phase);
+extern void prof_thread_name(const char *name);
+extern void profile_init(void);
+extern void profile_report(FILE *fp);
+
+#define PROF_START(phase) \
+	do { if (__builtin_expect(profiling, 0)) prof_start(phase); } while (0)
+#define PROF_END(phase) \
+	do { if (__builtin_expect(profiling, 0)) prof_end(phase); } while (0)
+
+#endif /* __PROFILE_H__ */
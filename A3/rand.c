@@ -8,7 +8,7 @@
 
 
 
-extern struct frame *coremap;
+extern struct coremap coremap;
 
 /* Page to evict is chosen using the rand algorithm.
  * Returns the page frame number (which is also the index in the coremap)
@@ -21,14 +21,19 @@ int rand_evict() {
 	return idx;
 }
 
-/* This function is called on each access to a page to update any information
- * needed by the rand algorithm.
- * Input: The page table entry for the page that is being accessed.
+/* This function is called with batches of accessed pages to update any
+ * information needed by the rand algorithm.
+ * Input: The page table entries for the pages accessed, in order.
  */
-void rand_ref(pgtbl_entry_t *p) {
+void rand_ref_batch(pgtbl_entry_t **ptes, int n) {
 
 	return;
 }
 
 void rand_init() {
 }
+
+#define REPLAY_FN rand_replay
+#define REPLAY_REF_BATCH rand_ref_batch
+#define REPLAY_EVICT rand_evict
+#include "replay.h"
@@ -0,0 +1,95 @@
+/* Replay loop template.
+ *
+ * The generic replay_trace() in sim.c calls the replacement algorithm through
+ * the ref_fcn and evict_fcn pointers on every reference, which keeps the
+ * compiler from inlining even an empty ref function. Including this file
+ * from an algorithm's source file instead defines a copy of the replay loop
+ * in which the algorithm's functions are called directly, through the page
+ * access path in access.h that find_physpage() also uses. The algorithm
+ * selects its loop through the replay field of its struct policy (see
+ * policy.h), once, at startup.
+ *
+ * Define before including:
+ *   REPLAY_FN         name of the replay function to define
+ *   REPLAY_EVICT      function that chooses the victim frame
+ *   REPLAY_REF        function called on each reference, or
+ *   REPLAY_REF_BATCH  function called with batches of up to REF_BATCH_SIZE
+ *                     page table entries, in reference order. The pending
+ *                     batch is always delivered before REPLAY_EVICT is
+ *                     called and at the end of the trace.
+ */
+#include <stdio.h>
+#include "sim.h"
+#include "pagetable.h"
+#include "access.h"
+#include "prefetch.h"
+#include "cleaner.h"
+#include "memsched.h"
+
+#if !defined(REPLAY_FN) || !defined(REPLAY_EVICT)
+#error "REPLAY_FN and REPLAY_EVICT must be defined before including replay.h"
+#endif
+#if defined(REPLAY_REF) == defined(REPLAY_REF_BATCH)
+#error "Exactly one of REPLAY_REF and REPLAY_REF_BATCH must be defined"
+#endif
+
+#define REF_BATCH_SIZE 256
+
+#ifdef REPLAY_REF_BATCH
+static pgtbl_entry_t *replay_batch[REF_BATCH_SIZE];
+static int replay_nbatch = 0;
+
+static inline void replay_flush() {
+	if (replay_nbatch > 0) {
+		PROF_START(PROF_REF);
+		REPLAY_REF_BATCH(replay_batch, replay_nbatch);
+		PROF_END(PROF_REF);
+		replay_nbatch = 0;
+	}
+}
+
+static inline void replay_ref(pgtbl_entry_t *p) {
+	replay_batch[replay_nbatch++] = p;
+	if (replay_nbatch == REF_BATCH_SIZE) {
+		replay_flush();
+	}
+}
+#else
+static inline void replay_flush() {
+}
+
+static inline void replay_ref(pgtbl_entry_t *p) {
+	PROF_START(PROF_REF);
+	REPLAY_REF(p);
+	PROF_END(PROF_REF);
+}
+#endif
+
+void REPLAY_FN(FILE *infp) {
+	addr_t vaddr = 0;
+	char type;
+
+	while(read_ref(infp, &type, &vaddr)) {
+		if(debug)  {
+			printf("%c %lx\n", type, vaddr);
+		}
+		char *memptr = access_physpage(vaddr, type, REPLAY_EVICT,
+					       replay_flush, replay_ref);
+		if (!fast) {
+			check_mem(memptr, type, vaddr);
+		}
+		if (prefetching) {
+			access_prefetch_pages(REPLAY_EVICT, replay_flush);
+		}
+		if (ref_count >= clean_next) {
+			// The cleaner may ask the algorithm for its next victims
+			replay_flush();
+			cleaner_run();
+		}
+		if (ref_count >= sched_next) {
+			replay_flush();
+			memsched_run();
+		}
+	}
+	replay_flush();
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim.h"
+#include "pagetable.h"
+#include "stackdist.h"
+#include "traceio.h"
+
+/* Computes the reuse (LRU stack) distance distribution of a trace.
+ *
+ * The distance of a reference is the number of distinct pages referenced
+ * since the previous reference to the same page, including that page, so
+ * an LRU memory of m frames hits exactly the references with distance at
+ * most m. Distances are binned by powers of two and reported separately
+ * for each access type and overall. Memory is proportional to the number
+ * of distinct pages in the trace.
+ */
+
+#define NUM_BINS 64
+#define TYPES "ILSM"
+#define NUM_TYPES 4
+
+// hist[t][0] counts cold references; hist[t][b] for b > 0 counts
+// distances in [2^(b-1), 2^b). The last row is the total over all types.
+static unsigned long hist[NUM_TYPES + 1][NUM_BINS + 1];
+
+// Used by parse_ref(), as in sim
+unsigned page_shift = 0;
+addr_t page_mask;
+
+static int dist_bin(unsigned long dist) {
+	int b = 0;
+
+	while (dist != 0) {
+		dist >>= 1;
+		b++;
+	}
+	return b;
+}
+
+static void print_histogram() {
+	unsigned long total = 0, cum = 0;
+	int t, b, last = 0;
+
+	for (b = 0; b <= NUM_BINS; b++) {
+		total += hist[NUM_TYPES][b];
+		if (hist[NUM_TYPES][b] != 0) {
+			last = b;
+		}
+	}
+
+	printf("%-24s", "distance");
+	for (t = 0; t < NUM_TYPES; t++) {
+		printf(" %12c", TYPES[t]);
+	}
+	printf(" %12s %8s\n", "all", "cum %");
+
+	for (b = 1; b <= last; b++) {
+		char range[48];
+		unsigned long lo = 1UL << (b - 1), hi = (1UL << b) - 1;
+
+		if (lo == hi) {
+			snprintf(range, sizeof(range), "%lu", lo);
+		} else {
+			snprintf(range, sizeof(range), "%lu-%lu", lo, hi);
+		}
+		cum += hist[NUM_TYPES][b];
+		printf("%-24s", range);
+		for (t = 0; t <= NUM_TYPES; t++) {
+			printf(" %12lu", hist[t][b]);
+		}
+		printf(" %8.3f\n", total ? (double)cum / total * 100 : 0);
+	}
+	printf("%-24s", "cold");
+	for (t = 0; t <= NUM_TYPES; t++) {
+		printf(" %12lu", hist[t][0]);
+	}
+	printf("\n%-24s", "total");
+	for (t = 0; t < NUM_TYPES; t++) {
+		unsigned long n = 0;
+		for (b = 0; b <= NUM_BINS; b++) {
+			n += hist[t][b];
+		}
+		printf(" %12lu", n);
+	}
+	printf(" %12lu\n", total);
+}
+
+int main(int argc, char *argv[]) {
+	int opt;
+	FILE *tfp = stdin;
+	char *tracefile = NULL;
+	char buf[MAXLINE];
+	struct stackdist *sd;
+	unsigned long pagesize = PAGE_SIZE;
+
+	while ((opt = getopt(argc, argv, "f:p:")) != -1) {
+		switch (opt) {
+		case 'f':
+			tracefile = optarg;
+			break;
+		case 'p':
+			pagesize = parse_size(optarg);
+			break;
+		default:
+			fprintf(stderr, "USAGE: reusedist [-f tracefile] [-p pagesize]\n");
+			exit(1);
+		}
+	}
+	if (pagesize == 0 || (pagesize & (pagesize - 1)) != 0) {
+		fprintf(stderr, "Error: page size must be a power of two\n");
+		exit(1);
+	}
+	while ((1UL << page_shift) < pagesize) {
+		page_shift++;
+	}
+	page_mask = ~(addr_t)(pagesize - 1);
+	if(tracefile != NULL) {
+		if((tfp = trace_open(tracefile)) == NULL) {
+			perror("Error opening tracefile:");
+			exit(1);
+		}
+	}
+
+	sd = sd_create();
+	while (fgets(buf, MAXLINE, tfp) != NULL) {
+		char type;
+		addr_t vaddr;
+		int b, t;
+
+		// No page table here, so any address can be measured
+		if (buf[0] == '=' || parse_ref(buf, &type, &vaddr, 0) == 0) {
+			continue;
+		}
+		t = strchr(TYPES, type) - TYPES;
+		b = dist_bin(sd_ref(sd, vaddr >> page_shift));
+		hist[t][b]++;
+		hist[NUM_TYPES][b]++;
+	}
+
+	if (tfp != stdin && trace_close(tfp) != 0) {
+		exit(1);
+	}
+	print_histogram();
+	printf("Distinct pages: %lu\n", sd_size(sd));
+	sd_destroy(sd);
+
+	return 0;
+}
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "sim.h"
+#include "shards.h"
+#include "stackdist.h"
+
+#define SHARDS_MODULUS  (1 << 24)   // hash values are taken modulo this
+
+// Buckets of scaled stack distance, 4 per power of two
+#define MRC_SUB      4
+#define MRC_BUCKETS  (40 * MRC_SUB)
+
+// Student's t for a 95% interval with SHARDS_GROUPS - 1 degrees of freedom
+#define T_95         2.365
+
+int sampling = 0;
+double sample_rate = 1.0;
+
+static uint64_t keep_threshold;     // pages below this are simulated
+static uint64_t mrc_threshold;      // pages below this feed the curve
+static unsigned long mrc_max_pages;
+static struct stackdist *mrc_sd;
+
+static unsigned long total_refs = 0;
+static unsigned long sampled_refs = 0;
+
+// Per-group weighted count of references by distance bucket, and of cold
+// references. Each reference is weighted by 1/rate at the time it was
+// seen, so buckets stay comparable after the threshold is lowered.
+static double mrc_hist[SHARDS_GROUPS][MRC_BUCKETS];
+static double mrc_cold[SHARDS_GROUPS];
+static double mrc_total[SHARDS_GROUPS];
+
+static inline uint64_t page_hash(uint64_t page) {
+	page ^= page >> 31;
+	page *= 0x7fb5d329728ea185ULL;
+	page ^= page >> 27;
+	page *= 0x81dadef4bc2dd44dULL;
+	page ^= page >> 33;
+	return page;
+}
+
+static inline uint64_t hash_value(uint64_t h) {
+	return h % SHARDS_MODULUS;
+}
+
+static inline int hash_group(uint64_t h) {
+	return (h >> 40) % SHARDS_GROUPS;
+}
+
+static int mrc_bucket(double dist) {
+	int b = (int)(log2(dist) * MRC_SUB);
+	return b < MRC_BUCKETS ? b : MRC_BUCKETS - 1;
+}
+
+void shards_init(double rate, unsigned long max_pages) {
+	sampling = 1;
+	sample_rate = rate;
+	keep_threshold = mrc_threshold = (uint64_t)(rate * SHARDS_MODULUS);
+	mrc_max_pages = max_pages;
+	mrc_sd = sd_create();
+}
+
+static int above_threshold(uint64_t page, void *arg) {
+	return hash_value(page_hash(page)) >= mrc_threshold;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static int collect_hash(uint64_t page, void *arg) {
+	uint64_t **next = arg;
+	*(*next)++ = hash_value(page_hash(page));
+	return 0;
+}
+
+/* Lowers mrc_threshold so that about 7/8 of the tracked pages remain, and
+ * forgets the rest. Lowering in steps keeps the cost per new page low.
+ */
+static void lower_threshold() {
+	unsigned long n = sd_size(mrc_sd);
+	uint64_t *hashes = malloc(n * sizeof(uint64_t)), *next = hashes;
+
+	if (hashes == NULL) {
+		perror("Failed to allocate SHARDS hashes");
+		exit(1);
+	}
+	sd_remove_if(mrc_sd, collect_hash, &next);
+	qsort(hashes, n, sizeof(uint64_t), cmp_u64);
+	mrc_threshold = hashes[n - n / 8];
+	free(hashes);
+	sd_remove_if(mrc_sd, above_threshold, NULL);
+}
+
+/* Returns nonzero if the reference to vaddr is in the sample and should
+ * be simulated. Every reference passes through here, so this also keeps
+ * the total reference count.
+ */
+int shards_keep(addr_t vaddr) {
+	uint64_t page = vaddr >> page_shift;
+	uint64_t h = page_hash(page);
+	uint64_t v = hash_value(h);
+
+	total_refs++;
+	if (v < mrc_threshold) {
+		double weight = (double)SHARDS_MODULUS / mrc_threshold;
+		unsigned long dist = sd_ref(mrc_sd, page);
+		int g = hash_group(h);
+
+		if (dist == 0) {
+			mrc_cold[g] += weight;
+		} else {
+			mrc_hist[g][mrc_bucket(dist * weight)] += weight;
+		}
+		mrc_total[g] += weight;
+		if (mrc_max_pages && sd_size(mrc_sd) > mrc_max_pages) {
+			lower_threshold();
+		}
+	}
+	if (v < keep_threshold) {
+		sampled_refs++;
+		return 1;
+	}
+	return 0;
+}
+
+// Miss ratio of group g (or of all groups if g < 0) for a cache that holds
+// every distance in buckets 0..b
+static double miss_ratio(int g, int b) {
+	double miss = 0, total = 0;
+	int i, k;
+
+	for (i = 0; i < SHARDS_GROUPS; i++) {
+		if (g >= 0 && i != g) {
+			continue;
+		}
+		miss += mrc_cold[i];
+		for (k = b + 1; k < MRC_BUCKETS; k++) {
+			miss += mrc_hist[i][k];
+		}
+		total += mrc_total[i];
+	}
+	return total > 0 ? miss / total : 0;
+}
+
+void shards_report(FILE *fp) {
+	int g, b, last = 0;
+	unsigned long prev_size = 0;
+	double rate = (double)mrc_threshold / SHARDS_MODULUS;
+
+	fprintf(fp, "\nSampled references: %lu of %lu (rate %g, memsize %u)\n",
+		sampled_refs, total_refs, sample_rate, memsize);
+	fprintf(fp, "LRU miss ratio curve (final rate %g, %lu pages tracked):\n",
+		rate, sd_size(mrc_sd));
+	fprintf(fp, "  %12s %10s %10s\n", "frames", "miss rate", "+/- 95%");
+
+	for (b = 0; b < MRC_BUCKETS; b++) {
+		for (g = 0; g < SHARDS_GROUPS; g++) {
+			if (mrc_hist[g][b] != 0) {
+				last = b;
+			}
+		}
+	}
+	for (b = 0; b <= last; b++) {
+		// Largest distance that falls in bucket b
+		unsigned long size = (unsigned long)ceil(exp2((double)(b + 1) / MRC_SUB)) - 1;
+		double mr = miss_ratio(-1, b), sum = 0, sumsq = 0, se;
+		int n = 0;
+
+		// Sizes below one sampled page's worth of distance can't be
+		// resolved, so start the curve at 1/rate
+		if (size == prev_size || size < 1 / rate) {
+			continue;
+		}
+		prev_size = size;
+		for (g = 0; g < SHARDS_GROUPS; g++) {
+			if (mrc_total[g] > 0) {
+				double r = miss_ratio(g, b);
+				sum += r;
+				sumsq += r * r;
+				n++;
+			}
+		}
+		// Standard error of the mean of the groups, with the finite
+		// population correction for sampling a fraction of the pages
+		se = n > 1 ? (sumsq - sum * sum / n) / (n - 1) / n : 0;
+		se = se > 0 ? sqrt(se) : 0;
+		se *= sqrt(1 - rate);
+		fprintf(fp, "  %12lu %10.4f %10.4f\n", size, mr * 100,
+			T_95 * se * 100);
+	}
+}
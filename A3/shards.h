@@ -0,0 +1,33 @@
+#ifndef __SHARDS_H__
+#define __SHARDS_H__
+
+#include <stdio.h>
+#include "pagetable.h"
+
+/* SHARDS spatial sampling, enabled with sim --sample-rate R.
+ *
+ * A page is in the sample if a hash of its page number falls below
+ * R times the hash range, so every reference to a sampled page is kept
+ * and every reference to any other page is dropped. The chosen algorithm
+ * simulates only the sampled references, with memsize scaled by R.
+ *
+ * Alongside, the sampled references drive an LRU miss ratio curve. Each
+ * stack distance is scaled by 1/R. The curve tracks at most --sample-max
+ * distinct pages: when it would track more, its own threshold is lowered
+ * and pages above the new threshold are forgotten (fixed-size SHARDS).
+ * --sample-max 0 disables the limit, so memory grows with the number of
+ * distinct sampled pages; mrc_check.sh uses it for the exact curve.
+ * Its error bounds come from splitting the sample into SHARDS_GROUPS
+ * independent sub-samples by other bits of the same hash.
+ */
+
+#define SHARDS_GROUPS 8
+
+extern int sampling;
+extern double sample_rate;
+
+extern void shards_init(double rate, unsigned long max_pages);
+extern int shards_keep(addr_t vaddr);
+extern void shards_report(FILE *fp);
+
+#endif /* __SHARDS_H__ */
@@ -4,32 +4,49 @@
 #include <getopt.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include "sim.h"
 #include "pagetable.h"
+#include "cost.h"
+#include "window.h"
+#include "traceio.h"
+#include "tier.h"
+#include "prefetch.h"
+#include "cleaner.h"
+#include "memsched.h"
+#include "policy.h"
 
 // Define global variables declared in sim.h
 unsigned memsize = 0;
 int debug = 0;
 char *physmem = NULL;
-struct frame *coremap = NULL;
+unsigned frame_bytes = SIMPAGESIZE;
+int fast = 0;
+struct coremap coremap;
 char *tracefile = NULL;
-
-/* The algs array gives us a mapping between the name of an eviction
- * algorithm as given in a command line argument, and the function to
- * call to select the victim page.
- */
-struct functions algs[] = {
-	{"rand", rand_init, rand_ref, rand_evict}, 
-	{"lru", lru_init, lru_ref, lru_evict},
-	{"fifo", fifo_init, fifo_ref, fifo_evict},
-	{"clock",clock_init, clock_ref, clock_evict},
-	{"opt", opt_init, opt_ref, opt_evict}
-};
-int num_algs = 5;
+int dedup = 0;
+addr_t dedup_page = 1; // not page aligned, so never equal to a reference
+int dedup_dirty = 0;
+unsigned long trace_line = 0;
 
 void (*init_fcn)() = NULL;
 void (*ref_fcn)(pgtbl_entry_t *) = NULL;
 int (*evict_fcn)() = NULL;
+void (*on_insert_fcn)(int, addr_t, char) = NULL;
+void (*on_hit_fcn)(int, char) = NULL;
+void (*on_evict_fcn)(int, int) = NULL;
+void (*on_move_fcn)(int, int) = NULL;
+void (*on_free_fcn)(int) = NULL;
+void (*replay_fcn)(FILE *) = NULL;
+
+/* Adapts an algorithm's ref_batch function for the generic replay loop,
+ * which delivers references one at a time.
+ */
+static void (*ref_batch_fcn)(pgtbl_entry_t **, int) = NULL;
+
+static void ref_one(pgtbl_entry_t *p) {
+	ref_batch_fcn(&p, 1);
+}
 
 
 /* An actual memory access based on the vaddr from the trace file.
@@ -48,38 +65,151 @@ int (*evict_fcn)() = NULL;
  */
 void access_mem(char type, addr_t vaddr) {
 	char *memptr = find_physpage(vaddr, type);
-	int *versionptr = (int *)memptr;
-	addr_t *checkaddr = (addr_t *)(memptr + sizeof(int));
 
-	if (*checkaddr != vaddr) {
-		fprintf(stderr,"Error, simulated page returned by pagetable lookup doese not have expected value.\n");
+	if (!fast) {
+		check_mem(memptr, type, vaddr);
 	}
-	
-	if (type == 'S' || type == 'M') {
-		// write access to page, increment version number
-		(*versionptr)++;
+	if (prefetching) {
+		prefetch_pages();
+	}
+	if (ref_count >= clean_next) {
+		cleaner_run();
+	}
+	if (ref_count >= sched_next) {
+		memsched_run();
 	}
-
 }
 
 
 void replay_trace(FILE *infp) {
-	char buf[MAXLINE];
 	addr_t vaddr = 0;
 	char type;
 
-	while(fgets(buf, MAXLINE, infp) != NULL) {
-		if(buf[0] != '=') {
-			sscanf(buf, "%c %lx", &type, &vaddr);
-			if(debug)  {
-				printf("%c %lx\n", type, vaddr);
-			}
-			access_mem(type, vaddr);
+	while(read_ref(infp, &type, &vaddr)) {
+		if(debug)  {
+			printf("%c %lx\n", type, vaddr);
+		}
+		access_mem(type, vaddr);
+	}
+}
+
+
+/* Replays n synthetic references instead of a trace (--stress), to check
+ * that the counts and swap offsets stay right past 2^32 references and 2G
+ * of swap. Pages are drawn with a xorshift generator from swapsize pages,
+ * and every fourth reference is a write.
+ */
+void stress_trace(unsigned long n, unsigned swapsize) {
+	unsigned long npages = swapsize;
+	unsigned long maxpages = (unsigned long)PTRS_PER_PGDIR * PTRS_PER_PGTBL;
+	uint64_t x = 88172645463325252ULL;
+	unsigned long i;
+
+	if (npages > maxpages) {
+		npages = maxpages;
+	}
+	for (i = 0; i < n; i++) {
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		access_mem((i & 3) == 3 ? 'S' : 'L', (x % npages) << page_shift);
+	}
+	if (ref_count != n || hit_count + miss_count != n) {
+		fprintf(stderr, "Error: stress counts are wrong: %lu references, "
+			"%lu hits, %lu misses for %lu replayed\n",
+			ref_count, hit_count, miss_count, n);
+		exit(1);
+	}
+}
+
+
+// Returns n as a percentage of total, or 0 if total is 0
+static double percent(unsigned long n, unsigned long total) {
+	return total ? (double)n / total * 100 : 0;
+}
+
+// What to print about the final page table (--dump)
+enum { DUMP_NONE, DUMP_SUMMARY, DUMP_FULL, DUMP_JSON };
+static char *dump_names[] = {"none", "summary", "full", "json"};
+
+// Prints s as a JSON string
+static void print_json_string(char *s) {
+	putchar('"');
+	for (; *s != '\0'; s++) {
+		if (*s == '"' || *s == '\\') {
+			printf("\\%c", *s);
+		} else if ((unsigned char)*s < 0x20) {
+			printf("\\u%04x", *s);
 		} else {
-			continue;
+			putchar(*s);
 		}
+	}
+	putchar('"');
+}
 
+// Returns the largest resident set size of the process so far, in KB
+static long peak_rss_kb() {
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return -1;
 	}
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+// Returns the CPU time, user and system, used by the process so far
+static double cpu_seconds() {
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return -1;
+	}
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+		(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/* Prints the configuration, counts and per-directory page counts of the
+ * run as one JSON object on a line, for tools that sweep over runs.
+ */
+static void print_results_json(char *alg, unsigned swapsize) {
+	unsigned resident, swapped;
+	int i, first = 1;
+
+	printf("{\"tracefile\": ");
+	if (tracefile != NULL) {
+		print_json_string(tracefile);
+	} else {
+		printf("null");
+	}
+	printf(", \"algorithm\": ");
+	print_json_string(alg);
+	printf(", \"memsize\": %u, \"swapsize\": %u, \"pagesize\": %lu, "
+	       "\"frame_bytes\": %u", memsize, swapsize, 1UL << page_shift,
+	       frame_bytes);
+	printf(", \"hits\": %lu, \"misses\": %lu, \"clean_evictions\": %lu, "
+	       "\"dirty_evictions\": %lu, \"references\": %lu",
+	       hit_count, miss_count, evict_clean_count, evict_dirty_count,
+	       ref_count);
+	printf(", \"hit_rate\": %.4f, \"miss_rate\": %.4f",
+	       percent(hit_count, ref_count), percent(miss_count, ref_count));
+	printf(", \"swap_slots_used\": %u, \"swap_slots_peak\": %u, "
+	       "\"swap_bytes_peak\": %lu", swap_slots_used(), swap_slots_peak(),
+	       (unsigned long)swap_slots_peak() * frame_bytes);
+	printf(", \"peak_rss_kb\": %ld", peak_rss_kb());
+	printf(", \"cpu_sec\": %.6f", cpu_seconds());
+	printf(", \"pagedir\": [");
+	for (i = 0; i < PTRS_PER_PGDIR; i++) {
+		if (count_pagetbl(i, &resident, &swapped)) {
+			printf("%s{\"index\": %d, \"resident\": %u, \"swapped\": %u}",
+			       first ? "" : ", ", i, resident, swapped);
+			first = 0;
+		}
+	}
+	printf("]}\n");
 }
 
 
@@ -88,9 +218,72 @@ int main(int argc, char *argv[]) {
 	unsigned swapsize = 4096;
 	FILE *tfp = stdin;
 	char *replacement_alg = NULL;
-	char *usage = "USAGE: sim -f tracefile -m memorysize -s swapsize -a algorithm\n";
+	struct policy *policy;
+	char *usage = "USAGE: sim -f tracefile -m memorysize -s swapsize -a algorithm [options]\n"
+		"  -s swapsize               initial swap slots, doubled when they run out\n"
+		"  -p pagesize               page size in bytes, a power of two >= 4K\n"
+		"  --frame-bytes N           simulated bytes per frame and swap slot\n"
+		"  --far-mem N               add a far memory tier of N frames\n"
+		"  --promote K               promote far pages on their Kth reference\n"
+		"  --prefetch seq|stride|markov\n"
+		"                            prefetch pages on each miss\n"
+		"  --prefetch-degree D       pages prefetched at a time (default 1)\n"
+		"  --clean-every K           run a background page cleaner every K\n"
+		"                            references\n"
+		"  --clean-pages N           pages the cleaner writes per run (default 16)\n"
+		"  --mem-schedule file       resize the memory at given references\n"
+		"  --stress N                replay N synthetic references, not a trace\n"
+		"  --dump none|summary|full|json\n"
+		"                            final page table output (default summary);\n"
+		"                            json replaces the counts with one JSON line\n"
+		"  --profile                 print time spent in each phase\n"
+		"  --cost[=event=ns,...]     report modeled runtime and latency\n"
+		"  --window N                print statistics every N references\n"
+		"  --window-file file        write --window statistics to file\n"
+		"  --sample-rate R           simulate a fraction R of the pages\n"
+		"  --sample-max pages        pages tracked for the sampled curve\n"
+		"                            (default 8192, at least 64; 0 for no\n"
+		"                            limit, using memory for every sampled page)\n"
+		"  --dedup                   drop repeated references to a page\n"
+		"  --fast                    count only, without page contents or swap I/O\n"
+		"The trace may be a reduced trace or raw Valgrind lackey output,\n"
+		"and a tracefile may be compressed with gzip or zstd.\n";
+	double rate = 0;
+	unsigned long sample_max = 8192;
+	int window = 0;
+	int dump = DUMP_SUMMARY;
+	unsigned long stress = 0;
+	unsigned far_mem = 0, promote = 1;
+	char *prefetcher = NULL;
+	int prefetch_degree = 1;
+	unsigned long clean_every = 0;
+	int clean_pages = 16;
+	char *schedule_file = NULL;
+	unsigned long pagesize = PAGE_SIZE, fbytes = SIMPAGESIZE;
+	char *window_file = NULL;
+	struct option long_opts[] = {
+		{"profile", no_argument, NULL, 'P'},
+		{"cost", optional_argument, NULL, 'C'},
+		{"window", required_argument, NULL, 'W'},
+		{"window-file", required_argument, NULL, 'O'},
+		{"sample-rate", required_argument, NULL, 'R'},
+		{"sample-max", required_argument, NULL, 'X'},
+		{"dedup", no_argument, NULL, 'D'},
+		{"fast", no_argument, NULL, 'F'},
+		{"frame-bytes", required_argument, NULL, 'B'},
+		{"dump", required_argument, NULL, 'U'},
+		{"stress", required_argument, NULL, 'T'},
+		{"far-mem", required_argument, NULL, 'G'},
+		{"promote", required_argument, NULL, 'K'},
+		{"prefetch", required_argument, NULL, 'H'},
+		{"prefetch-degree", required_argument, NULL, 'E'},
+		{"clean-every", required_argument, NULL, 'Q'},
+		{"clean-pages", required_argument, NULL, 'N'},
+		{"mem-schedule", required_argument, NULL, 'L'},
+		{NULL, 0, NULL, 0}
+	};
 
-	while ((opt = getopt(argc, argv, "f:m:a:s:")) != -1) {
+	while ((opt = getopt_long(argc, argv, "f:m:a:s:p:", long_opts, NULL)) != -1) {
 		switch (opt) {
 		case 'f':
 			tracefile = optarg;
@@ -104,63 +297,266 @@ int main(int argc, char *argv[]) {
 		case 's':
 			swapsize = (unsigned)strtoul(optarg, NULL, 10);
 			break;
+		case 'p':
+			pagesize = parse_size(optarg);
+			break;
+		case 'B':
+			fbytes = parse_size(optarg);
+			break;
+		case 'G':
+			far_mem = (unsigned)strtoul(optarg, NULL, 10);
+			break;
+		case 'K':
+			promote = (unsigned)strtoul(optarg, NULL, 10);
+			break;
+		case 'H':
+			prefetcher = optarg;
+			break;
+		case 'E':
+			prefetch_degree = (int)strtol(optarg, NULL, 10);
+			break;
+		case 'Q':
+			clean_every = strtoul(optarg, NULL, 10);
+			break;
+		case 'N':
+			clean_pages = (int)strtol(optarg, NULL, 10);
+			break;
+		case 'L':
+			schedule_file = optarg;
+			break;
+		case 'T':
+			stress = strtoul(optarg, NULL, 10);
+			break;
+		case 'U':
+			for (dump = DUMP_JSON; dump >= 0; dump--) {
+				if (strcmp(optarg, dump_names[dump]) == 0) {
+					break;
+				}
+			}
+			if (dump < 0) {
+				fprintf(stderr, "%s", usage);
+				exit(1);
+			}
+			break;
+		case 'P':
+			profile_init();
+			break;
+		case 'C':
+			if (cost_init(optarg) != 0) {
+				fprintf(stderr, "%s", usage);
+				exit(1);
+			}
+			break;
+		case 'W':
+			window = (int)strtol(optarg, NULL, 10);
+			break;
+		case 'O':
+			window_file = optarg;
+			break;
+		case 'R':
+			rate = strtod(optarg, NULL);
+			break;
+		case 'X':
+			sample_max = strtoul(optarg, NULL, 10);
+			break;
+		case 'D':
+			dedup = 1;
+			break;
+		case 'F':
+			fast = 1;
+			break;
 		default:
 			fprintf(stderr, "%s", usage);
 			exit(1);
 		}
 	}
-	if(tracefile != NULL) {
-		if((tfp = fopen(tracefile, "r")) == NULL) {
-			perror("Error opening tracefile:");
+	if (pagesize < PAGE_SIZE || pagesize > (1UL << 30) ||
+	    (pagesize & (pagesize - 1)) != 0) {
+		fprintf(stderr, "Error: page size must be a power of two from 4K to 1G\n");
+		exit(1);
+	}
+	page_mask = ~(addr_t)(pagesize - 1);
+	for (page_shift = 0; (1UL << page_shift) < pagesize; page_shift++)
+		;
+	// A frame holds a version number and the page's vaddr (see check_mem)
+	if (fbytes < SIMPAGESIZE || fbytes > (1UL << 30)) {
+		fprintf(stderr, "Error: frame bytes must be from %d to 1G\n", SIMPAGESIZE);
+		exit(1);
+	}
+	frame_bytes = fbytes;
+
+	if (rate != 0) {
+		if (rate < 0 || rate > 1 || (sample_max != 0 && sample_max < 64)) {
+			fprintf(stderr, "Error: sample rate must be in (0, 1] and sample max 0 or at least 64 pages\n");
 			exit(1);
 		}
+		shards_init(rate, sample_max);
+		// Simulate the sampled pages in a proportionally smaller memory
+		memsize = (unsigned)(memsize * rate + 0.5);
+		if (memsize == 0) {
+			memsize = 1;
+		}
+		far_mem = (unsigned)(far_mem * rate + 0.5);
+	}
+	if (window > 0) {
+		window_init(window, window_file);
+	}
+	if (schedule_file != NULL) {
+		// Far slots are numbered from memsize on
+		if (far_mem > 0) {
+			fprintf(stderr, "Error: --mem-schedule does not support --far-mem\n");
+			exit(1);
+		}
+		// Allocate for the largest size until init_fcn has run
+		memsize = memsched_init(schedule_file, rate != 0 ? rate : 1, memsize);
 	}
-
-	// Initialize main data structures for simulation.
-	// This happens before calling the replacement algorithm init function
-	// so that the init_fcn can refer to the coremap if needed.
-	coremap = calloc(memsize, sizeof(struct frame));
-	physmem = malloc(memsize * SIMPAGESIZE);
-	swap_init(swapsize);
-	init_pagetable();
 
 	// Initialize replacement algorithm functions.
 	if(replacement_alg == NULL) {
 		fprintf(stderr, "%s", usage);
 		exit(1);
-	} else {
-		int i;
-		for (i = 0; i < num_algs; i++) {
-			if(strcmp(algs[i].name, replacement_alg) == 0) {
-				init_fcn = algs[i].init;
-				ref_fcn = algs[i].ref;
-				evict_fcn = algs[i].evict;
-				break;
-			}
+	}
+	if ((policy = policy_find(replacement_alg)) == NULL) {
+		fprintf(stderr, "Error: invalid replacement algorithm - %s\n", 
+				replacement_alg);
+		exit(1);
+	}
+	init_fcn = policy->init;
+	ref_fcn = policy->ref;
+	evict_fcn = policy->evict;
+	on_insert_fcn = policy->on_insert;
+	on_hit_fcn = policy->on_hit;
+	on_evict_fcn = policy->on_evict;
+	on_move_fcn = policy->on_move;
+	on_free_fcn = policy->on_free;
+	replay_fcn = policy->replay;
+	if (ref_fcn == NULL) {
+		ref_batch_fcn = policy->ref_batch;
+		ref_fcn = ref_one;
+	}
+	// opt reads the whole trace itself, so it would not see the sample
+	if (sampling && init_fcn == opt_init) {
+		fprintf(stderr, "Error: opt does not support --sample-rate\n");
+		exit(1);
+	}
+	// opt only knows a page's next use when the page is referenced
+	if (prefetcher != NULL && init_fcn == opt_init) {
+		fprintf(stderr, "Error: opt does not support --prefetch\n");
+		exit(1);
+	}
+	if (clean_every > 0) {
+		if (clean_pages < 1 || clean_pages > 65536) {
+			fprintf(stderr, "Error: clean pages must be from 1 to 65536\n");
+			exit(1);
 		}
-		if(evict_fcn == NULL) {
-			fprintf(stderr, "Error: invalid replacement algorithm - %s\n", 
-					replacement_alg);
+		cleaner_init(clean_every, clean_pages, policy->victims);
+	}
+
+	// Initialize main data structures for simulation.
+	// This happens before calling the replacement algorithm init function
+	// so that the init_fcn can refer to the coremap if needed.
+	init_coremap(memsize, policy->meta_size);
+	if (far_mem > 0) {
+		tier_init(far_mem, promote);
+	}
+	if (!fast) {
+		// The far tier's frames follow the fast ones
+		physmem = malloc((size_t)(memsize + far_mem) * frame_bytes);
+		if (physmem == NULL) {
+			perror("Failed to allocate physical memory");
 			exit(1);
 		}
 	}
+	// The pages next to a sampled page are mostly not sampled
+	if (prefetcher != NULL && sampling) {
+		fprintf(stderr, "Error: --prefetch does not support --sample-rate\n");
+		exit(1);
+	}
+	if (prefetcher != NULL && prefetch_init(prefetcher, prefetch_degree) != 0) {
+		fprintf(stderr, "Error: unknown prefetcher %s or degree not from 1 to 64\n",
+			prefetcher);
+		exit(1);
+	}
+	swap_init(swapsize);
+	init_pagetable();
+
 	// Call replacement algorithm's init_fcn before replaying trace.
-	init_fcn();
+	// opt_init reads the trace itself, so only open it afterwards.
+	if (init_fcn != NULL) {
+		init_fcn();
+	}
+	if (schedule_file != NULL) {
+		memsched_start();
+	}
+	if(tracefile != NULL && !stress) {
+		if((tfp = trace_open(tracefile)) == NULL) {
+			perror("Error opening tracefile:");
+			exit(1);
+		}
+	}
 
-	replay_trace(tfp);
-	print_pagedirectory();
+	if (stress) {
+		stress_trace(stress, swapsize);
+	} else if (replay_fcn != NULL) {
+		replay_fcn(tfp);
+	} else {
+		replay_trace(tfp);
+	}
+	if (policy->destroy != NULL) {
+		policy->destroy();
+	}
+	if (window_size) {
+		window_finish();
+	}
+	if (tfp != stdin && trace_close(tfp) != 0) {
+		exit(1);
+	}
+	if (dump == DUMP_FULL) {
+		print_pagedirectory();
+	} else if (dump == DUMP_SUMMARY) {
+		print_pagedirectory_summary();
+	}
 
 	// Cleanup - removes temporary swapfile.
 	swap_destroy();
 
-	printf("\n");
-	printf("Hit count: %d\n", hit_count);
-	printf("Miss count: %d\n", miss_count);
-	printf("Clean evictions: %d\n",evict_clean_count);
-	printf("Dirty evictions: %d\n",evict_dirty_count); 
-	printf("Total references : %d\n", ref_count);
-	printf("Hit rate: %.4f\n", (double)hit_count/ref_count * 100);
-	printf("Miss rate: %.4f\n", (double)miss_count/ref_count *100);
+	if (far_frames) {
+		tier_report(stdout);
+	}
+	if (prefetching) {
+		prefetch_report(stdout);
+	}
+	if (clean_every > 0) {
+		cleaner_report(stdout);
+	}
+	if (schedule_file != NULL) {
+		memsched_report(stdout);
+	}
+	if (cost_model) {
+		cost_report(stdout);
+	}
+	if (sampling) {
+		shards_report(stdout);
+	}
+
+	if (dump == DUMP_JSON) {
+		print_results_json(replacement_alg, swapsize);
+	} else {
+		printf("\nPeak swap use: %u slots, %lu bytes\n", swap_slots_peak(),
+		       (unsigned long)swap_slots_peak() * frame_bytes);
+		printf("\n");
+		printf("Hit count: %lu\n", hit_count);
+		printf("Miss count: %lu\n", miss_count);
+		printf("Clean evictions: %lu\n",evict_clean_count);
+		printf("Dirty evictions: %lu\n",evict_dirty_count); 
+		printf("Total references : %lu\n", ref_count);
+		printf("Hit rate: %.4f\n", percent(hit_count, ref_count));
+		printf("Miss rate: %.4f\n", percent(miss_count, ref_count));
+	}
+
+	if (profiling) {
+		profile_report(stderr);
+	}
 		
 	return(0);
 }
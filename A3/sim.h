@@ -2,20 +2,32 @@
 #define __SIM_H__
 
 #include "pagetable.h"
+#include "profile.h"
+#include "shards.h"
 #define MAXLINE 256
-#define SIMPAGESIZE 16  /* Simulated physical memory page frame size */
+#define SIMPAGESIZE 16  /* Default simulated physical memory page frame size */
 
 extern unsigned memsize;
 extern int debug;
 
-extern int hit_count;
-extern int miss_count;
-extern int ref_count;
-extern int evict_clean_count;
-extern int evict_dirty_count;
+extern unsigned long hit_count;
+extern unsigned long miss_count;
+extern unsigned long ref_count;
+extern unsigned long evict_clean_count;
+extern unsigned long evict_dirty_count;
 
-/* We simulate physical memory with a large array of bytes */
+/* We simulate physical memory with a large array of bytes, frame_bytes
+ * per frame. Swap slots are the same size.
+ */
 extern char *physmem;
+extern unsigned frame_bytes;
+
+/* With --fast, only the page table, coremap and swap slot bitmap are
+ * simulated. There is no physmem and no swap file, so page contents are
+ * neither initialized, copied to and from swap nor checked, but the
+ * counts are the same as in a full simulation.
+ */
+extern int fast;
 
 /* The tracefile name is a global variable because the OPT
  * algorithm will need to read the file before you start
@@ -23,17 +35,136 @@ extern char *physmem;
  */
 extern char *tracefile;
 
-// Each eviction algorithm is represented by a structure with its name
-// and three functions.
-struct functions {
-	char *name;                  // String name of eviction algorithm
-	void (*init)(void);          // Initialize any data needed by alg
-	void (*ref)(pgtbl_entry_t *);    // Called on each reference
-	int (*evict)();              // Called to choose victim for eviction
-};
-
+// The replacement algorithm's functions (see policy.h). The event
+// functions are NULL if the algorithm does not need them.
 extern void (*init_fcn)();
 extern void (*ref_fcn)(pgtbl_entry_t *);
 extern int (*evict_fcn)();
+extern void (*on_insert_fcn)(int, addr_t, char);
+extern void (*on_hit_fcn)(int, char);
+extern void (*on_evict_fcn)(int, int);
+extern void (*on_move_fcn)(int, int);
+extern void (*on_free_fcn)(int);
+
+/* With --dedup, a reference to the same page as the previous one is
+ * dropped, unless it is the first write to the page since then. Such a
+ * reference is always a hit that doesn't change the order of pages, so
+ * only the hit and reference counts change.
+ */
+extern int dedup;
+extern addr_t dedup_page;
+extern int dedup_dirty;
+extern unsigned long trace_line;  // lines of the trace read so far
+
+/* Parses a size in bytes with an optional K, M or G suffix. Returns 0 if
+ * the string is not such a size.
+ */
+static inline unsigned long parse_size(char *s) {
+	char *end;
+	unsigned long size = strtoul(s, &end, 10);
+
+	switch (*end) {
+	case 'K': case 'k':
+		size <<= 10, end++;
+		break;
+	case 'M': case 'm':
+		size <<= 20, end++;
+		break;
+	case 'G': case 'g':
+		size <<= 30, end++;
+		break;
+	}
+	return (end == s || *end != '\0') ? 0 : size;
+}
+
+/* Parses one trace line into type and vaddr. Both the reduced traces
+ * ("L 4c07000") and raw Valgrind lackey output (" L 04222cac,4",
+ * "I  0400d7d4,3") are accepted; lackey addresses are rounded down to
+ * the start of their page, which is what the simulation works with.
+ * Returns 0 if the line is not a reference, and, if check_range is set,
+ * -1 if its address is outside the address space the page table covers
+ * (valgrind's stack addresses, for example).
+ */
+static inline int parse_ref(char *buf, char *type, addr_t *vaddr,
+			    int check_range) {
+	char *p = buf, *end;
+
+	if (*p == ' ') { // lackey indents data references
+		p++;
+	}
+	if ((*p != 'I' && *p != 'L' && *p != 'S' && *p != 'M') || p[1] != ' ') {
+		return 0;
+	}
+	*type = *p;
+	*vaddr = strtoul(p + 1, &end, 16) & page_mask;
+	if (end == p + 1 || (*end != '\n' && *end != ',' && *end != '\0' &&
+			     *end != ' ')) {
+		return 0;
+	}
+	if (check_range &&
+	    *vaddr >> page_shift >= (addr_t)PTRS_PER_PGDIR * PTRS_PER_PGTBL) {
+		return -1;
+	}
+	return 1;
+}
+
+/* Reads the next reference from the trace into type and vaddr, skipping
+ * lines that are not references, duplicates dropped by --dedup and, when
+ * sampling, references to pages outside the sample. Returns 0 at the end
+ * of the trace.
+ */
+static inline int read_ref(FILE *infp, char *type, addr_t *vaddr) {
+	char buf[MAXLINE];
+	int ok;
+
+	PROF_START(PROF_PARSE);
+	while(fgets(buf, MAXLINE, infp) != NULL) {
+		trace_line++;
+		if(buf[0] == '=' || (ok = parse_ref(buf, type, vaddr, 1)) == 0) {
+			continue;
+		}
+		if (ok < 0) {
+			fprintf(stderr, "Error: trace line %lu: address outside the "
+				"%lu-page address space: %s", trace_line,
+				(unsigned long)PTRS_PER_PGDIR * PTRS_PER_PGTBL, buf);
+			exit(1);
+		}
+		if (dedup) {
+			int write = (*type == 'S' || *type == 'M');
+			if (*vaddr == dedup_page && (dedup_dirty || !write)) {
+				continue;
+			}
+			dedup_dirty = (*vaddr == dedup_page && dedup_dirty) || write;
+			dedup_page = *vaddr;
+		}
+		if (sampling && !shards_keep(*vaddr)) {
+			continue;
+		}
+		PROF_END(PROF_PARSE);
+		return 1;
+	}
+	PROF_END(PROF_PARSE);
+	return 0;
+}
+
+/* Checks that the (simulated) page returned by find_physpage() holds the
+ * expected content (just a copy of the virtual address) and, in case of a
+ * write reference, increments the version counter.
+ */
+static inline void check_mem(char *memptr, char type, addr_t vaddr) {
+	int *versionptr = (int *)memptr;
+	addr_t *checkaddr = (addr_t *)(memptr + sizeof(int));
+
+	PROF_START(PROF_VERIFY);
+	if (*checkaddr != vaddr) {
+		fprintf(stderr,"Error, simulated page returned by pagetable lookup doese not have expected value.\n");
+	}
+	
+	if (type == 'S' || type == 'M') {
+		// write access to page, increment version number
+		(*versionptr)++;
+	}
+	PROF_END(PROF_VERIFY);
+}
 
 #endif // __SIM_H 
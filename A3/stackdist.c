@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stackdist.h"
+
+#define SD_MIN_TABLE  1024    // initial hash table slots (power of two)
+#define SD_MIN_TIMES  4096    // initial number of time slots in the tree
+
+// Hash table entry. A time of 0 marks an empty slot.
+struct sd_entry {
+	uint64_t key;
+	unsigned long time;
+};
+
+struct stackdist {
+	struct sd_entry *table;
+	unsigned long tsize;     // number of slots, a power of two
+	unsigned long count;     // number of keys in table
+
+	uint32_t *tree;          // Fenwick tree over times 1..tcap
+	unsigned long tcap;
+	unsigned long now;       // last time handed out
+};
+
+static void *sd_alloc(size_t size) {
+	void *p = calloc(1, size);
+	if (p == NULL) {
+		perror("Failed to allocate stack distance tables");
+		exit(1);
+	}
+	return p;
+}
+
+static inline uint64_t sd_hash(uint64_t key) {
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	return key;
+}
+
+//---------------------------------------------------------------------
+// Fenwick tree
+
+static inline void tree_add(struct stackdist *sd, unsigned long t, int delta) {
+	for (; t <= sd->tcap; t += t & -t) {
+		sd->tree[t] += delta;
+	}
+}
+
+// Returns the number of marked times in 1..t
+static inline unsigned long tree_sum(struct stackdist *sd, unsigned long t) {
+	unsigned long sum = 0;
+	for (; t > 0; t -= t & -t) {
+		sum += sd->tree[t];
+	}
+	return sum;
+}
+
+static int cmp_time(const void *a, const void *b) {
+	unsigned long ta = (*(struct sd_entry **)a)->time;
+	unsigned long tb = (*(struct sd_entry **)b)->time;
+	return ta < tb ? -1 : ta > tb;
+}
+
+/* Renumbers the last access times of all keys to 1..count, keeping their
+ * order, and rebuilds the tree with room for at least as many new times.
+ */
+static void sd_compact(struct stackdist *sd) {
+	struct sd_entry **live = sd_alloc((sd->count + 1) * sizeof(*live));
+	unsigned long i, n = 0;
+
+	for (i = 0; i < sd->tsize; i++) {
+		if (sd->table[i].time != 0) {
+			live[n++] = &sd->table[i];
+		}
+	}
+	qsort(live, n, sizeof(*live), cmp_time);
+	for (i = 0; i < n; i++) {
+		live[i]->time = i + 1;
+	}
+	free(live);
+
+	if (sd->tcap < 2 * n) {
+		sd->tcap = 2 * n;
+	}
+	free(sd->tree);
+	sd->tree = sd_alloc((sd->tcap + 1) * sizeof(uint32_t));
+	// Build the tree with times 1..n marked in O(tcap)
+	for (i = 1; i <= sd->tcap; i++) {
+		unsigned long parent = i + (i & -i);
+		sd->tree[i] += (i <= n);
+		if (parent <= sd->tcap) {
+			sd->tree[parent] += sd->tree[i];
+		}
+	}
+	sd->now = n;
+}
+
+//---------------------------------------------------------------------
+// Hash table with linear probing
+
+static struct sd_entry *sd_find(struct stackdist *sd, uint64_t key) {
+	unsigned long i = sd_hash(key) & (sd->tsize - 1);
+	while (sd->table[i].time != 0 && sd->table[i].key != key) {
+		i = (i + 1) & (sd->tsize - 1);
+	}
+	return &sd->table[i];
+}
+
+static void sd_grow(struct stackdist *sd) {
+	struct sd_entry *old = sd->table;
+	unsigned long i, oldsize = sd->tsize;
+
+	sd->tsize *= 2;
+	sd->table = sd_alloc(sd->tsize * sizeof(struct sd_entry));
+	for (i = 0; i < oldsize; i++) {
+		if (old[i].time != 0) {
+			*sd_find(sd, old[i].key) = old[i];
+		}
+	}
+	free(old);
+}
+
+// Removes the entry in slot e, moving later entries of its probe
+// sequence back so that lookups do not need tombstones.
+static void sd_delete(struct stackdist *sd, struct sd_entry *e) {
+	unsigned long i = e - sd->table, j = i, home;
+
+	sd->table[i].time = 0;
+	for (;;) {
+		j = (j + 1) & (sd->tsize - 1);
+		if (sd->table[j].time == 0) {
+			break;
+		}
+		home = sd_hash(sd->table[j].key) & (sd->tsize - 1);
+		// Move j back to i unless its home lies cyclically in (i, j]
+		if ((i <= j) ? (home <= i || home > j) : (home <= i && home > j)) {
+			sd->table[i] = sd->table[j];
+			sd->table[j].time = 0;
+			i = j;
+		}
+	}
+	sd->count--;
+}
+
+//---------------------------------------------------------------------
+
+struct stackdist *sd_create() {
+	struct stackdist *sd = sd_alloc(sizeof(struct stackdist));
+
+	sd->tsize = SD_MIN_TABLE;
+	sd->table = sd_alloc(sd->tsize * sizeof(struct sd_entry));
+	sd->tcap = SD_MIN_TIMES;
+	sd->tree = sd_alloc((sd->tcap + 1) * sizeof(uint32_t));
+	return sd;
+}
+
+void sd_destroy(struct stackdist *sd) {
+	free(sd->table);
+	free(sd->tree);
+	free(sd);
+}
+
+unsigned long sd_ref(struct stackdist *sd, uint64_t key) {
+	struct sd_entry *e;
+	unsigned long dist = 0;
+
+	if (sd->now == sd->tcap) {
+		sd_compact(sd);
+	}
+	if (2 * (sd->count + 1) > sd->tsize) {
+		sd_grow(sd);
+	}
+
+	e = sd_find(sd, key);
+	if (e->time != 0) {
+		dist = tree_sum(sd, sd->now) - tree_sum(sd, e->time) + 1;
+		tree_add(sd, e->time, -1);
+	} else {
+		e->key = key;
+		sd->count++;
+	}
+	e->time = ++sd->now;
+	tree_add(sd, e->time, 1);
+
+	return dist;
+}
+
+void sd_remove_if(struct stackdist *sd,
+		  int (*drop)(uint64_t key, void *arg), void *arg) {
+	uint64_t *keys = sd_alloc((sd->count + 1) * sizeof(uint64_t));
+	unsigned long i, n = 0;
+
+	for (i = 0; i < sd->tsize; i++) {
+		if (sd->table[i].time != 0 && drop(sd->table[i].key, arg)) {
+			keys[n++] = sd->table[i].key;
+		}
+	}
+	for (i = 0; i < n; i++) {
+		struct sd_entry *e = sd_find(sd, keys[i]);
+		tree_add(sd, e->time, -1);
+		sd_delete(sd, e);
+	}
+	free(keys);
+}
+
+unsigned long sd_size(struct stackdist *sd) {
+	return sd->count;
+}
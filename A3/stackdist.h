@@ -0,0 +1,36 @@
+#ifndef __STACKDIST_H__
+#define __STACKDIST_H__
+
+#include <stdint.h>
+
+/* Exact LRU stack distances over a stream of keys (page numbers).
+ *
+ * Each key's last access time is kept in a hash table, and a Fenwick tree
+ * over access times marks the times that are some key's last access. The
+ * stack distance of a reference is then the number of marks after the
+ * key's previous access, found in O(log n). When the clock reaches the
+ * end of the tree, the live times are renumbered 1..n, so memory stays
+ * proportional to the number of distinct keys however long the stream is.
+ */
+
+struct stackdist;
+
+extern struct stackdist *sd_create(void);
+extern void sd_destroy(struct stackdist *sd);
+
+/* Records a reference to key. Returns its stack distance, where 1 means
+ * the key was also the previous reference, or 0 if this is the first
+ * reference to key.
+ */
+extern unsigned long sd_ref(struct stackdist *sd, uint64_t key);
+
+/* Forgets keys for which drop(key, arg) is nonzero, as if they had never
+ * been referenced. Distances of the remaining keys no longer count them.
+ */
+extern void sd_remove_if(struct stackdist *sd,
+			 int (*drop)(uint64_t key, void *arg), void *arg);
+
+/* Returns the number of distinct keys being tracked */
+extern unsigned long sd_size(struct stackdist *sd);
+
+#endif /* __STACKDIST_H__ */
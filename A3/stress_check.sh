@@ -0,0 +1,19 @@
+#!/bin/bash
+# Runs sim --stress with more than 2^19 frames, so that frame numbers
+# shifted into the pte need more than 32 bits, and with swap offsets past
+# 2G, with and without --fast. sim checks its own counts; this exits with
+# status 1 if any run fails.
+# Usage: ./stress_check.sh [references]
+
+refs=${1:-3000000}
+status=0
+
+for fast in "" --fast; do
+	for algo in rand clock; do
+		cmd="./sim -m 600000 -s 1200000 -a $algo $fast --stress $refs"
+		$cmd > /dev/null || { echo "FAILED: $cmd"; status=1; }
+	done
+	cmd="./sim -m 100 -s 3000 --frame-bytes 1M -a rand $fast --stress 20000"
+	$cmd > /dev/null || { echo "FAILED: $cmd"; status=1; }
+done
+exit $status
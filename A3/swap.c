@@ -5,13 +5,16 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #include "pagetable.h"
 #include "sim.h"
 
 //---------------------------------------------------------------------
 // Bitmap definitions and functions to manage space in swapfile.
-// We create a fixed-size swapfile, although it could be made larger
-// on demand with a little effort.
+// The bitmap starts with swapsize bits and doubles whenever it is full,
+// so the swapfile grows on demand. The file is only written at the slots
+// in use, so it stays sparse. A page keeps its slot while it is resident
+// and clean, and frees it on the first store (see pte_set_dirty()).
 //
 // The bitmap code is modified from the OS/161 bitmap functions.
 
@@ -23,8 +26,29 @@
 struct bitmap {
         unsigned nbits;
         unsigned *v;
+        unsigned hint;  /* no word below this one has a free bit */
 };
 
+/* Mark any leftover bits at the end in use */
+static
+void
+bitmap_mark_leftover(struct bitmap *b)
+{
+        unsigned words = DIVROUNDUP(b->nbits, BITS_PER_WORD);
+
+        if (words > b->nbits / BITS_PER_WORD) {
+                unsigned j, ix = words-1;
+                unsigned overbits = b->nbits - ix*BITS_PER_WORD;
+
+                assert(b->nbits / BITS_PER_WORD == words-1);
+                assert(overbits > 0 && overbits < BITS_PER_WORD);
+                
+                for (j=overbits; j<BITS_PER_WORD; j++) {
+                        b->v[ix] |= ((unsigned)1 << j);
+                }
+        }
+}
+
 struct bitmap *
 bitmap_create(unsigned nbits)
 {
@@ -44,21 +68,42 @@ bitmap_create(unsigned nbits)
 
         memset(b->v, 0, words*sizeof(unsigned));
         b->nbits = nbits;
+        b->hint = 0;
+        bitmap_mark_leftover(b);
 
-        /* Mark any leftover bits at the end in use */
-        if (words > nbits / BITS_PER_WORD) {
-                unsigned j, ix = words-1;
-                unsigned overbits = nbits - ix*BITS_PER_WORD;
+        return b;
+}
 
-                assert(nbits / BITS_PER_WORD == words-1);
-                assert(overbits > 0 && overbits < BITS_PER_WORD);
-                
-                for (j=overbits; j<BITS_PER_WORD; j++) {
-                        b->v[ix] |= ((unsigned)1 << j);
-                }
+/* Grows the bitmap to nbits bits, the new ones clear. Returns 0 on
+ * success, 1 if out of memory.
+ */
+int
+bitmap_grow(struct bitmap *b, unsigned nbits)
+{
+        unsigned oldwords = DIVROUNDUP(b->nbits, BITS_PER_WORD);
+        unsigned words = DIVROUNDUP(nbits, BITS_PER_WORD);
+        unsigned *v;
+
+        assert(nbits >= b->nbits);
+        v = realloc(b->v, words*sizeof(unsigned));
+        if (v == NULL) {
+                return 1;
         }
+        b->v = v;
 
-        return b;
+        /* Clear the leftover bits of the old last word, now real bits */
+        if (oldwords > b->nbits / BITS_PER_WORD) {
+                b->v[oldwords-1] &=
+                        ((unsigned)1 << (b->nbits % BITS_PER_WORD)) - 1;
+        }
+        memset(b->v + oldwords, 0, (words-oldwords)*sizeof(unsigned));
+        if (b->hint > oldwords - 1 && oldwords > 0) {
+                b->hint = oldwords - 1;
+        }
+        b->nbits = nbits;
+        bitmap_mark_leftover(b);
+
+        return 0;
 }
 
 int
@@ -68,8 +113,9 @@ bitmap_alloc(struct bitmap *b, unsigned *index)
         unsigned maxix = DIVROUNDUP(b->nbits, BITS_PER_WORD);
         unsigned offset;
 
-        for (ix=0; ix<maxix; ix++) {
+        for (ix=b->hint; ix<maxix; ix++) {
                 if (b->v[ix]!=WORD_ALLBITS) {
+                        b->hint = ix;
                         for (offset = 0; offset < BITS_PER_WORD; offset++) {
                                 unsigned mask = ((unsigned)1) << offset;
 
@@ -83,6 +129,7 @@ bitmap_alloc(struct bitmap *b, unsigned *index)
                         assert(0);
                 }
         }
+        b->hint = maxix;
         return 1;
 }
 
@@ -121,6 +168,9 @@ bitmap_unmark(struct bitmap *b, unsigned index)
 
         assert((b->v[ix] & mask)!=0);
         b->v[ix] &= ~mask;
+        if (ix < b->hint) {
+                b->hint = ix;
+        }
 }
 
 
@@ -147,18 +197,26 @@ bitmap_destroy(struct bitmap *b)
 static int swapfd;
 static struct bitmap *swapmap;
 static char *fname;
+static unsigned swap_used = 0; // number of slots allocated in swapmap
+static unsigned swap_peak = 0; // largest value of swap_used so far
+static unsigned long swap_write_count = 0; // pages written to the swapfile
 
 int swap_init(unsigned swapsize) {
 
-	// Initialize the swap file
-	fname = malloc(20);
-	strncpy(fname, "swapfile.XXXXXX",20);
-	if ((swapfd = mkstemp(fname)) == -1) {
-		perror("Failed to create temporary file for swap");
-		exit(1);
+	// Initialize the swap file, unless only slots are tracked (--fast)
+	if (!fast) {
+		fname = malloc(20);
+		strncpy(fname, "swapfile.XXXXXX",20);
+		if ((swapfd = mkstemp(fname)) == -1) {
+			perror("Failed to create temporary file for swap");
+			exit(1);
+		}
 	}
 
-	// Initialize the bitmap
+	// Initialize the bitmap, which grows when it fills up
+	if (swapsize == 0) {
+		swapsize = 1;
+	}
 	if ((swapmap = bitmap_create(swapsize)) == NULL) {
 		fprintf(stderr,"Failed to create bitmap for swap\n");
 		exit(1);
@@ -170,14 +228,39 @@ int swap_init(unsigned swapsize) {
 void swap_destroy() {
 
 	// Close and remove swapfile
-	close(swapfd);
-	unlink(fname);
+	if (!fast) {
+		close(swapfd);
+		unlink(fname);
+	}
 
 	// Destroy bitmap
 	bitmap_destroy(swapmap);
 	return;
 }
 
+// Returns the number of page slots currently allocated in the swap file.
+unsigned swap_slots_used() {
+	return swap_used;
+}
+
+// Returns the largest number of page slots that were allocated at once.
+unsigned swap_slots_peak() {
+	return swap_peak;
+}
+
+// Returns the number of pages written to the swap file.
+unsigned long swap_writes() {
+	return swap_write_count;
+}
+
+// Frees the slot at 'swap_offset' in the swap file, whose content is no
+// longer needed.
+void swap_free(off_t swap_offset) {
+	assert(swap_offset != INVALID_SWAP);
+	bitmap_unmark(swapmap, swap_offset / frame_bytes);
+	swap_used--;
+}
+
 // Read data into (simulated) physical memory 'frame' from 'swap_offset'
 // in swap file.
 // Input:  frame - the physical frame number (not byte offset) in physmem
@@ -185,15 +268,18 @@ void swap_destroy() {
 // Return: 0 on success, 
 //	   -errno on error or number of bytes read on partial read
 // 
-int swap_pagein(unsigned frame, int swap_offset) {
+int swap_pagein(unsigned frame, off_t swap_offset) {
 	char *frame_ptr;
 	off_t pos;
 	ssize_t bytes_read;
 	
 	assert(swap_offset != INVALID_SWAP);
+	if (fast) {
+		return 0;
+	}
 
 	// Get pointer to page data in (simulated) physical memory
-	frame_ptr = &physmem[frame * SIMPAGESIZE];
+	frame_ptr = &physmem[(size_t)frame * frame_bytes];
 
 	// Seek to position in swap file where this page was stored
 	pos = lseek(swapfd, swap_offset, SEEK_SET);
@@ -204,8 +290,8 @@ int swap_pagein(unsigned frame, int swap_offset) {
 	}
 
 	// Read page data from swapfile into memory
-	bytes_read = read(swapfd, frame_ptr, SIMPAGESIZE);
-	if (bytes_read != SIMPAGESIZE) {
+	bytes_read = read(swapfd, frame_ptr, frame_bytes);
+	if (bytes_read != frame_bytes) {
 		fprintf(stderr,"swap_pagein: did not read whole page\n");
 		return bytes_read;
 	}
@@ -219,7 +305,7 @@ int swap_pagein(unsigned frame, int swap_offset) {
 // Return: the swap_offset where the data was written on success,
 //         or INVALID_SWAP on failure
 // 
-int swap_pageout(unsigned frame, int swap_offset) {
+off_t swap_pageout(unsigned frame, off_t swap_offset) {
 	char *frame_ptr;
 	off_t pos;
 	unsigned idx;
@@ -228,15 +314,28 @@ int swap_pageout(unsigned frame, int swap_offset) {
 	// Check if swap has already been allocated for this page 
 	if (swap_offset == INVALID_SWAP) {
 		if (bitmap_alloc(swapmap, &idx) != 0) {
-			fprintf(stderr,"swap_pageout: Could not allocate space in swapfile. Try running again with a larger swapsize.\n");
-			return INVALID_SWAP;
+			// Full, so double the swap space
+			unsigned nbits = swapmap->nbits;
+			unsigned newbits = nbits <= UINT_MAX / 4 ? 2 * nbits : nbits;
+			if (newbits == nbits || bitmap_grow(swapmap, newbits) != 0 ||
+			    bitmap_alloc(swapmap, &idx) != 0) {
+				fprintf(stderr,"swap_pageout: Could not allocate space in swapfile.\n");
+				return INVALID_SWAP;
+			}
+		}
+		swap_offset = (off_t)idx * frame_bytes;
+		if (++swap_used > swap_peak) {
+			swap_peak = swap_used;
 		}
-		swap_offset = idx*SIMPAGESIZE;
 	}
 	assert(swap_offset != INVALID_SWAP);
+	swap_write_count++;
+	if (fast) {
+		return swap_offset;
+	}
 
 	// Get pointer to page data in (simulated) physical memory
-	frame_ptr = &physmem[frame * SIMPAGESIZE];
+	frame_ptr = &physmem[(size_t)frame * frame_bytes];
 
 	// Seek to position in swap file where this page will be stored
 	pos = lseek(swapfd, swap_offset, SEEK_SET);
@@ -247,8 +346,8 @@ int swap_pageout(unsigned frame, int swap_offset) {
 	}
 
 	// Read page data from swapfile into memory
-	bytes_written = write(swapfd, frame_ptr, SIMPAGESIZE);
-	if (bytes_written != SIMPAGESIZE) {
+	bytes_written = write(swapfd, frame_ptr, frame_bytes);
+	if (bytes_written != frame_bytes) {
 		fprintf(stderr,"swap_pageout: did not write whole page\n");
 		return INVALID_SWAP;
 	}
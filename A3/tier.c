@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "pagetable.h"
+#include "cost.h"
+#include "window.h"
+#include "tier.h"
+
+unsigned far_frames = 0;
+
+static unsigned promote_after = 1;
+
+// Far tier slots. A far slot s holds its page in physmem frame memsize + s.
+static pgtbl_entry_t **far_pte;  // page in each slot, NULL if free
+static unsigned *far_count;      // references since demotion, aged
+static char *far_refbit;         // referenced since the hand last passed
+static unsigned *free_slots;     // stack of free slots
+static unsigned num_free;
+static unsigned clock_hand = 0;
+
+// Content of the page being promoted, whose slot has already been freed
+static char *promote_buf;
+
+static unsigned long far_hits = 0;
+static unsigned long promotions = 0;
+static unsigned long demotions = 0;
+static unsigned long far_evictions = 0;
+
+static void *tier_alloc(size_t n, size_t size) {
+	void *p = calloc(n, size);
+	if (p == NULL) {
+		perror("Failed to allocate far tier");
+		exit(1);
+	}
+	return p;
+}
+
+/* Sets up a far tier of nframes frames. Pages are promoted on their
+ * promote'th reference since demotion, or never if promote is 0.
+ */
+void tier_init(unsigned nframes, unsigned promote) {
+	unsigned i;
+
+	far_frames = nframes;
+	promote_after = promote;
+	far_pte = tier_alloc(nframes, sizeof(pgtbl_entry_t *));
+	far_count = tier_alloc(nframes, sizeof(unsigned));
+	far_refbit = tier_alloc(nframes, sizeof(char));
+	free_slots = tier_alloc(nframes, sizeof(unsigned));
+	promote_buf = tier_alloc(1, frame_bytes);
+
+	// Hand out slot 0 first
+	for (i = 0; i < nframes; i++) {
+		free_slots[i] = nframes - 1 - i;
+	}
+	num_free = nframes;
+}
+
+static inline char *slot_mem(unsigned slot) {
+	return &physmem[(size_t)(memsize + slot) * frame_bytes];
+}
+
+/* Returns a free far slot. If there is none, the page in the slot chosen
+ * by CLOCK is evicted to swap.
+ */
+static unsigned far_alloc() {
+	unsigned slot;
+
+	if (num_free > 0) {
+		return free_slots[--num_free];
+	}
+	for (;;) {
+		slot = clock_hand;
+		clock_hand = (clock_hand + 1) % far_frames;
+		if (far_refbit[slot]) {
+			far_refbit[slot] = 0;
+			far_count[slot] /= 2;
+			continue;
+		}
+		swap_out_page(far_pte[slot], memsize + slot);
+		far_evictions++;
+		return slot;
+	}
+}
+
+/* Moves the page in fast frame 'frame', chosen as the victim by the
+ * replacement algorithm, to the far tier.
+ */
+void tier_demote(int frame) {
+	pgtbl_entry_t *p = coremap.pte[frame];
+	unsigned slot = far_alloc();
+
+	if (!fast) {
+		memcpy(slot_mem(slot), &physmem[(size_t)frame * frame_bytes],
+		       frame_bytes);
+	}
+	far_pte[slot] = p;
+	far_count[slot] = 0;
+	far_refbit[slot] = 0;
+	p->frame = ((unsigned long)(memsize + slot) << PAGE_SHIFT) |
+		(p->frame & ~PAGE_MASK & ~PG_VALID) | PG_FAR;
+	demotions++;
+}
+
+/* Counts a reference to the far-tier page p as a hit. Returns 1 if the
+ * page is now hot enough to be promoted, in which case its slot is freed
+ * and the page must be loaded into a fast frame with load_frame().
+ */
+int tier_promote(pgtbl_entry_t *p) {
+	unsigned slot = (p->frame >> PAGE_SHIFT) - memsize;
+
+	hit_count++;
+	far_hits++;
+	far_refbit[slot] = 1;
+	if (promote_after == 0 || ++far_count[slot] < promote_after) {
+		return 0;
+	}
+
+	// The victim demoted to make room may take the slot
+	if (!fast) {
+		memcpy(promote_buf, slot_mem(slot), frame_bytes);
+	}
+	far_pte[slot] = NULL;
+	free_slots[num_free++] = slot;
+	return 1;
+}
+
+/* Completes a reference to the far-tier page p that was not promoted, and
+ * returns a pointer to the page in (simulated) physical memory.
+ */
+char *tier_ref(pgtbl_entry_t *p, char type) {
+	p->frame |= PG_REF;
+	ref_count++;
+	if (type == 'S' || type == 'M') {
+		pte_set_dirty(p);
+	}
+	if (window_size) {
+		window_ref(p);
+	}
+	if (cost_model) {
+		cost_add(cost_ns[COST_FAR] - cost_ns[COST_HIT]);
+	}
+
+	if (fast) {
+		return NULL;
+	}
+	return &physmem[(size_t)(p->frame >> PAGE_SHIFT) * frame_bytes];
+}
+
+/* Fills fast frame 'frame' with the page p being promoted.
+ */
+void tier_load(pgtbl_entry_t *p, int frame) {
+	if (!fast) {
+		memcpy(&physmem[(size_t)frame * frame_bytes], promote_buf,
+		       frame_bytes);
+	}
+	p->frame &= ~PG_FAR;
+	promotions++;
+}
+
+void tier_report(FILE *fp) {
+	unsigned long fast_hits = hit_count - far_hits;
+	double fast_ns = fast_hits * cost_ns[COST_HIT];
+	double far_ns = far_hits * cost_ns[COST_FAR];
+	double migrate_ns = promotions * cost_ns[COST_PROMOTE] +
+		demotions * cost_ns[COST_DEMOTE];
+
+	fprintf(fp, "\nTwo-tier memory: %u fast frames, %u far frames, ",
+		memsize, far_frames);
+	if (promote_after == 0) {
+		fprintf(fp, "no promotion\n");
+	} else {
+		fprintf(fp, "promotion on reference %u\n", promote_after);
+	}
+	fprintf(fp, "Fast tier hits: %lu\n", fast_hits);
+	fprintf(fp, "Far tier hits: %lu\n", far_hits);
+	fprintf(fp, "Promotions: %lu\n", promotions);
+	fprintf(fp, "Demotions: %lu\n", demotions);
+	fprintf(fp, "Far tier evictions: %lu\n", far_evictions);
+	fprintf(fp, "Modeled hit and migration time (ms): %.3f "
+		"(fast %.3f, far %.3f, migration %.3f)\n",
+		(fast_ns + far_ns + migrate_ns) / 1e6, fast_ns / 1e6,
+		far_ns / 1e6, migrate_ns / 1e6);
+}
@@ -0,0 +1,34 @@
+#ifndef __TIER_H__
+#define __TIER_H__
+
+#include <stdio.h>
+#include "pagetable.h"
+
+/* Two-tier memory, enabled with sim --far-mem N.
+ *
+ * The memsize frames managed by the replacement algorithm are the fast
+ * tier. The far tier adds N slower frames between it and swap, stored in
+ * physmem after the fast frames. A page evicted from the fast tier is
+ * demoted to the far tier, and only pages evicted from the far tier, with
+ * CLOCK, go to swap. A far-tier page has PG_FAR set instead of PG_VALID,
+ * and the frame number in its pte is memsize plus its far slot.
+ *
+ * A reference to a far-tier page is a hit. It is served in place until
+ * the page has been referenced --promote K times (default 1) since it was
+ * demoted; then it is promoted back to the fast tier, demoting the victim
+ * chosen by the replacement algorithm if the fast tier is full. Each time
+ * the clock hand passes a page its count is halved, so only pages that
+ * are referenced often enough are promoted. With K = 0 pages are never
+ * promoted.
+ */
+
+extern unsigned far_frames;
+
+extern void tier_init(unsigned nframes, unsigned promote);
+extern void tier_demote(int frame);
+extern int tier_promote(pgtbl_entry_t *p);
+extern char *tier_ref(pgtbl_entry_t *p, char type);
+extern void tier_load(pgtbl_entry_t *p, int frame);
+extern void tier_report(FILE *fp);
+
+#endif /* __TIER_H__ */
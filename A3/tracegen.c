@@ -0,0 +1,463 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include "sim.h"
+#include "pagetable.h"
+#include "traceio.h"
+
+/* Generates synthetic traces from parametric models of page access.
+ *
+ * Each argument is a phase: one model, or a mixture of models joined by
+ * '+', each with an optional weight, "*w" (default 1). The phases take
+ * turns for -l references each (by default, the trace is split evenly
+ * between them). The models are:
+ *   zipf:PAGES:ALPHA       Zipf(ALPHA) distributed over PAGES pages, hot
+ *                          pages scattered over the region
+ *   uniform:PAGES          uniformly random over PAGES pages
+ *   loop:PAGES             PAGES pages in order, over and over
+ *   scan:PAGES[:RUN]       sequential runs of RUN (64) pages, each from a
+ *                          random page of the region
+ *   stride:PAGES:STRIDE    every STRIDE-th page, from the next page on each
+ *                          pass
+ * Each distinct model gets its own region of pages; the same model given
+ * in several phases refers to the same region and keeps its position.
+ * References are stores with probability -w and loads otherwise.
+ *
+ * The trace depends only on the arguments and the seed. It is written as
+ * text, or with -b in the binary format of traceio.h, which sim reads
+ * directly.
+ */
+
+#define MAX_MODELS   64
+#define OUTBUF_SIZE  (1 << 20)
+
+enum kind { ZIPF, UNIFORM, LOOP, SCAN, STRIDE };
+
+struct model {
+	char *spec;
+	enum kind kind;
+	unsigned long pages, base;
+	unsigned long arg;          // RUN for scan, STRIDE for stride
+	unsigned long pos, offset, left;
+	double alpha;
+	// Rejection-inversion sampling constants (see zipf_rank())
+	double hx1, hn, s;
+};
+
+struct phase {
+	int num;
+	int model[MAX_MODELS];
+	double cum[MAX_MODELS];     // cumulative weights, the last one 1
+};
+
+static struct model models[MAX_MODELS];
+static int num_models = 0;
+static struct phase *phases;
+static int num_phases;
+
+/* xoshiro256** seeded with splitmix64, so every seed gives a good stream
+ */
+static uint64_t rng[4];
+
+static inline uint64_t rotl(uint64_t x, int k) {
+	return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t next_rand() {
+	uint64_t result = rotl(rng[1] * 5, 7) * 9;
+	uint64_t t = rng[1] << 17;
+
+	rng[2] ^= rng[0];
+	rng[3] ^= rng[1];
+	rng[1] ^= rng[2];
+	rng[0] ^= rng[3];
+	rng[2] ^= t;
+	rng[3] = rotl(rng[3], 45);
+	return result;
+}
+
+static void seed_rand(uint64_t seed) {
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		rng[i] = z ^ (z >> 31);
+	}
+}
+
+// Uniform in [0, 1)
+static inline double rand_double() {
+	return (next_rand() >> 11) * 0x1.0p-53;
+}
+
+// Uniform in [0, n)
+static inline unsigned long rand_below(unsigned long n) {
+	return (unsigned __int128)next_rand() * n >> 64;
+}
+
+/* Zipf sampling by rejection-inversion (Hormann and Derflinger, 1996),
+ * which takes constant time and no tables for any number of pages.
+ */
+static inline double helper1(double x) {
+	return fabs(x) > 1e-8 ? log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+
+static inline double helper2(double x) {
+	return fabs(x) > 1e-8 ? expm1(x) / x : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+}
+
+static inline double zipf_h(struct model *m, double x) {
+	return exp(-m->alpha * log(x));
+}
+
+static inline double zipf_hint(struct model *m, double x) {
+	double logx = log(x);
+	return helper2((1 - m->alpha) * logx) * logx;
+}
+
+static inline double zipf_hint_inv(struct model *m, double x) {
+	double t = x * (1 - m->alpha);
+	return exp(helper1(t < -1 ? -1 : t) * x);
+}
+
+static void zipf_init(struct model *m) {
+	m->hx1 = zipf_hint(m, 1.5) - 1;
+	m->hn = zipf_hint(m, m->pages + 0.5);
+	m->s = 2 - zipf_hint_inv(m, zipf_hint(m, 2.5) - zipf_h(m, 2));
+}
+
+// Returns a rank from 1 to m->pages; rank r has probability ~ 1/r^alpha
+static inline unsigned long zipf_rank(struct model *m) {
+	for (;;) {
+		double u = m->hn + rand_double() * (m->hx1 - m->hn);
+		double x = zipf_hint_inv(m, u);
+		unsigned long k = x + 0.5;
+
+		if (k < 1) {
+			k = 1;
+		} else if (k > m->pages) {
+			k = m->pages;
+		}
+		if (k - x <= m->s || u >= zipf_hint(m, k + 0.5) - zipf_h(m, k)) {
+			return k;
+		}
+	}
+}
+
+// Returns the page number of the model's next reference
+static inline unsigned long next_page(struct model *m) {
+	unsigned long page;
+
+	switch (m->kind) {
+	case ZIPF:
+		// A multiplier that is prime, and so coprime to pages, scatters the
+		// ranks over the region
+		return m->base + (zipf_rank(m) - 1) * 2654435761UL % m->pages;
+	case UNIFORM:
+		return m->base + rand_below(m->pages);
+	case LOOP:
+		page = m->pos;
+		if (++m->pos == m->pages) {
+			m->pos = 0;
+		}
+		return m->base + page;
+	case SCAN:
+		if (m->left == 0) {
+			m->pos = rand_below(m->pages);
+			m->left = m->arg;
+		}
+		m->left--;
+		page = m->pos;
+		if (++m->pos == m->pages) {
+			m->pos = 0;
+		}
+		return m->base + page;
+	case STRIDE:
+		page = m->pos;
+		m->pos += m->arg;
+		if (m->pos >= m->pages) {
+			if (++m->offset == m->arg || m->offset == m->pages) {
+				m->offset = 0;
+			}
+			m->pos = m->offset;
+		}
+		return m->base + page;
+	}
+	return 0;
+}
+
+static void usage() {
+	fprintf(stderr, "USAGE: tracegen [-n refs] [-s seed] [-w write_ratio] "
+		"[-p pagesize] [-l phase_length] [-o file] [-b] phase...\n"
+		"  phase: model[*weight][+model[*weight]...]\n"
+		"  model: zipf:PAGES:ALPHA, uniform:PAGES, loop:PAGES, "
+		"scan:PAGES[:RUN], stride:PAGES:STRIDE\n");
+	exit(1);
+}
+
+// Parses a count such as 1000000 or 1e6
+static unsigned long parse_count(char *s, char *what) {
+	char *end;
+	double v = strtod(s, &end);
+
+	if (end == s || *end != '\0' || v < 0 || v >= 1.8e19 || v != floor(v)) {
+		fprintf(stderr, "Error: bad %s %s\n", what, s);
+		exit(1);
+	}
+	return v;
+}
+
+// Returns the index of the model given by spec, adding it if it is new
+static int find_model(char *spec) {
+	struct model *m;
+	char *name, *a1, *a2, *a3;
+	int i;
+
+	for (i = 0; i < num_models; i++) {
+		if (strcmp(models[i].spec, spec) == 0) {
+			return i;
+		}
+	}
+	if (num_models == MAX_MODELS) {
+		fprintf(stderr, "Error: at most %d models\n", MAX_MODELS);
+		exit(1);
+	}
+	m = &models[num_models];
+	memset(m, 0, sizeof(*m));
+	m->spec = strdup(spec);
+	name = strtok(spec, ":");
+	a1 = strtok(NULL, ":");
+	a2 = strtok(NULL, ":");
+	a3 = strtok(NULL, ":");
+	if (name == NULL || a1 == NULL || a3 != NULL) {
+		goto bad;
+	}
+	m->pages = parse_count(a1, "page count");
+	if (m->pages == 0) {
+		goto bad;
+	}
+	if (strcmp(name, "zipf") == 0 && a2 != NULL) {
+		m->kind = ZIPF;
+		m->alpha = strtod(a2, NULL);
+		if (!(m->alpha > 0)) {
+			goto bad;
+		}
+		zipf_init(m);
+	} else if (strcmp(name, "uniform") == 0 && a2 == NULL) {
+		m->kind = UNIFORM;
+	} else if (strcmp(name, "loop") == 0 && a2 == NULL) {
+		m->kind = LOOP;
+	} else if (strcmp(name, "scan") == 0) {
+		m->kind = SCAN;
+		m->arg = a2 != NULL ? parse_count(a2, "run length") : 64;
+		if (m->arg == 0) {
+			goto bad;
+		}
+	} else if (strcmp(name, "stride") == 0 && a2 != NULL) {
+		m->kind = STRIDE;
+		m->arg = parse_count(a2, "stride");
+		if (m->arg == 0) {
+			goto bad;
+		}
+	} else {
+		goto bad;
+	}
+	return num_models++;
+
+bad:
+	fprintf(stderr, "Error: bad model %s\n", m->spec);
+	usage();
+	return -1;
+}
+
+// Parses a phase, "model[*weight][+model[*weight]...]"
+static void parse_phase(struct phase *ph, char *arg) {
+	char *save, *spec, *w;
+	double weight, total = 0;
+	int i;
+
+	ph->num = 0;
+	for (spec = strtok_r(arg, "+", &save); spec != NULL;
+	     spec = strtok_r(NULL, "+", &save)) {
+		weight = 1;
+		if ((w = strchr(spec, '*')) != NULL) {
+			*w++ = '\0';
+			weight = strtod(w, NULL);
+			if (!(weight > 0)) {
+				fprintf(stderr, "Error: bad weight %s\n", w);
+				exit(1);
+			}
+		}
+		if (ph->num == MAX_MODELS) {
+			fprintf(stderr, "Error: at most %d models\n", MAX_MODELS);
+			exit(1);
+		}
+		ph->model[ph->num] = find_model(spec);
+		total += weight;
+		ph->cum[ph->num++] = total;
+	}
+	if (ph->num == 0) {
+		usage();
+	}
+	for (i = 0; i < ph->num; i++) {
+		ph->cum[i] /= total;
+	}
+	ph->cum[ph->num - 1] = 1;
+}
+
+/* Places each model's region after the previous one, starting on a new
+ * page table, and checks that they fit in the simulator's address space.
+ */
+static void place_models() {
+	unsigned long next = 0;
+	int i;
+
+	for (i = 0; i < num_models; i++) {
+		models[i].base = next;
+		next += (models[i].pages + PTRS_PER_PGTBL - 1) / PTRS_PER_PGTBL * PTRS_PER_PGTBL;
+		if (next > (unsigned long)PTRS_PER_PGDIR * PTRS_PER_PGTBL) {
+			fprintf(stderr, "Error: the models need more than %lu pages\n",
+				(unsigned long)PTRS_PER_PGDIR * PTRS_PER_PGTBL);
+			exit(1);
+		}
+	}
+}
+
+static inline void put_le64(char *p, uint64_t v) {
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		p[i] = v >> (8 * i);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	static char buf[OUTBUF_SIZE];
+	unsigned long refs = 1000000, seed = 1, pagesize = PAGE_SIZE;
+	unsigned long phase_len = 0, done, end, page;
+	uint64_t write_thresh;
+	double write_ratio = 0;
+	char *outfile = NULL, *p = buf, type;
+	int binary = 0, opt, i, ph, shift = 0;
+	struct phase *cur;
+	struct model *m;
+	FILE *out = stdout;
+
+	static struct option long_options[] = {
+		{"refs", required_argument, NULL, 'n'},
+		{"seed", required_argument, NULL, 's'},
+		{"write-ratio", required_argument, NULL, 'w'},
+		{"page-size", required_argument, NULL, 'p'},
+		{"phase-length", required_argument, NULL, 'l'},
+		{"output", required_argument, NULL, 'o'},
+		{"binary", no_argument, NULL, 'b'},
+		{NULL, 0, NULL, 0}
+	};
+
+	while ((opt = getopt_long(argc, argv, "n:s:w:p:l:o:b", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'n':
+			refs = parse_count(optarg, "reference count");
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			write_ratio = strtod(optarg, NULL);
+			if (!(write_ratio >= 0 && write_ratio <= 1)) {
+				fprintf(stderr, "Error: write ratio must be from 0 to 1\n");
+				exit(1);
+			}
+			break;
+		case 'p':
+			pagesize = parse_size(optarg);
+			break;
+		case 'l':
+			phase_len = parse_count(optarg, "phase length");
+			break;
+		case 'o':
+			outfile = optarg;
+			break;
+		case 'b':
+			binary = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (pagesize < 4096 || (pagesize & (pagesize - 1)) != 0) {
+		fprintf(stderr, "Error: page size must be a power of two of at least 4096\n");
+		exit(1);
+	}
+	while ((1UL << shift) < pagesize) {
+		shift++;
+	}
+	num_phases = argc - optind;
+	if (num_phases == 0) {
+		usage();
+	}
+	if ((phases = malloc(num_phases * sizeof(struct phase))) == NULL) {
+		perror("Failed to allocate phases");
+		exit(1);
+	}
+	for (i = 0; i < num_phases; i++) {
+		parse_phase(&phases[i], argv[optind + i]);
+	}
+	place_models();
+	if (phase_len == 0) {
+		phase_len = (refs + num_phases - 1) / num_phases;
+		if (phase_len == 0) {
+			phase_len = 1;
+		}
+	}
+	if (outfile != NULL && (out = fopen(outfile, "w")) == NULL) {
+		perror("Error opening output file:");
+		exit(1);
+	}
+	seed_rand(seed);
+	write_thresh = write_ratio * 0x1.0p64;
+
+	if (binary) {
+		memcpy(p, TRACE_BIN_MAGIC, 8);
+		p += 8;
+	}
+	for (done = 0, ph = 0; done < refs; done = end, ph = (ph + 1) % num_phases) {
+		cur = &phases[ph];
+		end = refs - done < phase_len ? refs : done + phase_len;
+		for (; done < end; done++) {
+			m = &models[cur->model[0]];
+			if (cur->num > 1) {
+				double u = rand_double();
+				for (i = 0; u >= cur->cum[i]; i++)
+					;
+				m = &models[cur->model[i]];
+			}
+			page = next_page(m);
+			type = write_ratio >= 1 || (write_ratio > 0 && next_rand() < write_thresh) ?
+				'S' : 'L';
+			if (binary) {
+				put_le64(p, (uint64_t)page << shift | (type == 'S' ? 2 : 1));
+				p += 8;
+			} else {
+				p += trace_format_ref(p, type, (uint64_t)page << shift);
+			}
+			if (p > buf + OUTBUF_SIZE - TRACE_LINE_MAX) {
+				fwrite(buf, 1, p - buf, out);
+				p = buf;
+			}
+		}
+	}
+	fwrite(buf, 1, p - buf, out);
+	if (fflush(out) != 0 || ferror(out)) {
+		perror("Error writing trace:");
+		exit(1);
+	}
+	if (out != stdout) {
+		fclose(out);
+	}
+	return 0;
+}
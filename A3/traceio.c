@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <zlib.h>
+#include "profile.h"
+#include "traceio.h"
+
+#define DECOMP_BUFSIZE (256 * 1024)
+#define PIPE_BUFSIZE   (1024 * 1024)
+
+static const unsigned char gzip_magic[] = { 0x1f, 0x8b };
+static const unsigned char zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+// State of the decompression thread. There is at most one compressed or
+// binary trace open at a time.
+static struct {
+	pthread_t thread;
+	FILE *fp;          // stream returned to the caller
+	gzFile gz;         // gzip input, or
+	FILE *bin;         // binary trace input, or
+	int child_fd;      // output of a zstd process
+	pid_t child;
+	int fd;            // write end of the pipe
+	int failed;        // the thread could not decode the whole trace
+	int stopped;       // the reader closed the stream before the end
+} decomp;
+
+/* Reads binary trace words from decomp.bin and writes them to out as text,
+ * up to size bytes. Returns the number of bytes written, 0 at the end of
+ * the trace, or -1 on an error.
+ */
+static int decode_binary(char *out, int size) {
+	static unsigned char words[DECOMP_BUFSIZE / TRACE_LINE_MAX * 8];
+	unsigned char *w;
+	uint64_t word;
+	size_t n, i;
+	char *p = out;
+	int b;
+
+	n = fread(words, 8, size / TRACE_LINE_MAX, decomp.bin);
+	for (i = 0; i < n; i++) {
+		w = &words[i * 8];
+		for (word = 0, b = 7; b >= 0; b--) {
+			word = word << 8 | w[b];
+		}
+		p += trace_format_ref(p, TRACE_BIN_TYPES[word & 3], word & ~(uint64_t)3);
+	}
+	if (n == 0 && (ferror(decomp.bin) || (ftell(decomp.bin) - 8) % 8 != 0)) {
+		fprintf(stderr, "Error decoding trace: %s\n", ferror(decomp.bin) ?
+			strerror(errno) : "truncated binary trace");
+		return -1;
+	}
+	return p - out;
+}
+
+static void *decompress_thread(void *arg) {
+	char *buf = malloc(DECOMP_BUFSIZE);
+	const char *msg;
+	int n, err;
+
+	if (buf == NULL) {
+		perror("Failed to allocate decompression buffer");
+		exit(1);
+	}
+	if (profiling) {
+		prof_thread_name("decompress");
+	}
+	for (;;) {
+		char *p;
+
+		PROF_START(PROF_DECOMPRESS);
+		if (decomp.gz != NULL) {
+			n = gzread(decomp.gz, buf, DECOMP_BUFSIZE);
+		} else if (decomp.bin != NULL) {
+			n = decode_binary(buf, DECOMP_BUFSIZE);
+		} else {
+			n = read(decomp.child_fd, buf, DECOMP_BUFSIZE);
+		}
+		PROF_END(PROF_DECOMPRESS);
+		if (n <= 0) {
+			break;
+		}
+		for (p = buf; n > 0; ) {
+			ssize_t written = write(decomp.fd, p, n);
+			if (written < 0) {
+				// The reader closed its end before the end of the trace
+				decomp.stopped = 1;
+				goto done;
+			}
+			p += written;
+			n -= written;
+		}
+	}
+	if (decomp.gz != NULL) {
+		// A truncated gzip stream reads as a short one
+		msg = gzerror(decomp.gz, &err);
+		if (err != Z_OK && err != Z_STREAM_END) {
+			fprintf(stderr, "Error decoding trace: %s\n", msg);
+			n = -1;
+		}
+	} else if (decomp.bin == NULL && n < 0) {
+		perror("Error reading from zstd");
+	}
+	decomp.failed = n < 0;
+done:
+	close(decomp.fd);
+	free(buf);
+	return NULL;
+}
+
+FILE *trace_open(const char *path) {
+	unsigned char magic[8] = { 0 };
+	size_t n;
+	int binary;
+	FILE *fp;
+	int fds[2];
+
+	if ((fp = fopen(path, "r")) == NULL) {
+		return NULL;
+	}
+	n = fread(magic, 1, sizeof(magic), fp);
+	binary = n == 8 && memcmp(magic, TRACE_BIN_MAGIC, 8) == 0;
+	if (!binary && (n < 2 ||
+	    (memcmp(magic, gzip_magic, sizeof(gzip_magic)) != 0 &&
+	     memcmp(magic, zstd_magic, sizeof(zstd_magic)) != 0))) {
+		rewind(fp);
+		return fp;
+	}
+	if (decomp.fp != NULL) {
+		fprintf(stderr, "trace_open: only one compressed or binary trace "
+			"can be open\n");
+		fclose(fp);
+		errno = EBUSY;
+		return NULL;
+	}
+	decomp.gz = NULL;
+	decomp.bin = NULL;
+	decomp.failed = 0;
+	decomp.stopped = 0;
+	if (binary) {
+		// Already past the magic number
+		decomp.bin = fp;
+	} else if (fclose(fp), memcmp(magic, gzip_magic, sizeof(gzip_magic)) == 0) {
+		if ((decomp.gz = gzopen(path, "r")) == NULL) {
+			return NULL;
+		}
+		gzbuffer(decomp.gz, DECOMP_BUFSIZE);
+	} else {
+		// No libzstd headers are assumed, so run the zstd command
+		if (pipe(fds) != 0) {
+			return NULL;
+		}
+		if ((decomp.child = fork()) == -1) {
+			return NULL;
+		}
+		if (decomp.child == 0) {
+			dup2(fds[1], STDOUT_FILENO);
+			close(fds[0]);
+			close(fds[1]);
+			execlp("zstd", "zstd", "-dcq", "--", path, (char *)NULL);
+			perror("Failed to run zstd");
+			_exit(127);
+		}
+		close(fds[1]);
+		decomp.child_fd = fds[0];
+	}
+
+	if (pipe(fds) != 0) {
+		return NULL;
+	}
+#ifdef F_SETPIPE_SZ
+	fcntl(fds[1], F_SETPIPE_SZ, PIPE_BUFSIZE);
+#endif
+	// Writes to a closed pipe should end the thread, not the process
+	signal(SIGPIPE, SIG_IGN);
+
+	decomp.fd = fds[1];
+	decomp.fp = fdopen(fds[0], "r");
+	if (decomp.fp == NULL) {
+		return NULL;
+	}
+	if (pthread_create(&decomp.thread, NULL, decompress_thread, NULL) != 0) {
+		perror("Failed to start decompression thread");
+		exit(1);
+	}
+	return decomp.fp;
+}
+
+/* Closes a trace opened with trace_open(). Returns 0, or -1 if a
+ * compressed or binary trace could not be decoded to its end, in which case
+ * the caller has not seen the whole trace and an error has been printed.
+ */
+int trace_close(FILE *fp) {
+	int status, failed = 0;
+
+	fclose(fp);
+	if (fp != decomp.fp) {
+		return 0;
+	}
+	pthread_join(decomp.thread, NULL);
+	failed = decomp.failed;
+	if (decomp.gz != NULL) {
+		if (gzclose(decomp.gz) != Z_OK && !decomp.stopped && !failed) {
+			fprintf(stderr, "Error decoding trace: gzip stream is corrupt\n");
+			failed = 1;
+		}
+	} else if (decomp.bin != NULL) {
+		fclose(decomp.bin);
+	} else {
+		close(decomp.child_fd);
+		// zstd is killed by the closed pipe if the reader stopped early
+		if (waitpid(decomp.child, &status, 0) == -1 ||
+		    (!decomp.stopped && !failed &&
+		     (!WIFEXITED(status) || WEXITSTATUS(status) != 0))) {
+			fprintf(stderr, "Error decoding trace: zstd failed\n");
+			failed = 1;
+		}
+	}
+	decomp.fp = NULL;
+	return failed ? -1 : 0;
+}
@@ -0,0 +1,52 @@
+#ifndef __TRACEIO_H__
+#define __TRACEIO_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Opening trace files that may be compressed or binary.
+ *
+ * trace_open() checks the first bytes of the file for the gzip or zstd
+ * magic number, or TRACE_BIN_MAGIC. A plain trace is opened with fopen().
+ * A compressed one is decompressed, and a binary one converted to text, by
+ * a separate thread that writes into a pipe, and the returned stream reads
+ * the other end, so decoding overlaps with whatever the caller does with
+ * the trace. With sim --profile, the thread's time shows up as the
+ * "decompress" phase of its own table. Decoding errors, such as a
+ * truncated gzip file or a failed zstd, are reported by trace_close(),
+ * and the caller should exit with an error, since it has not seen the
+ * whole trace.
+ *
+ * A binary trace (tracegen -b) is TRACE_BIN_MAGIC followed by one 64-bit
+ * little-endian word per reference: the page-aligned address, with the
+ * index of the reference type in TRACE_BIN_TYPES in the low two bits.
+ */
+
+#define TRACE_BIN_MAGIC  "PGTRACE1"
+#define TRACE_BIN_TYPES  "ILSM"
+#define TRACE_LINE_MAX   20    // longest line trace_format_ref() writes
+
+extern FILE *trace_open(const char *path);
+extern int trace_close(FILE *fp);
+
+/* Writes a reference as a trace line, "L 4c07000\n", to p, and returns its
+ * length. This is much faster than printf.
+ */
+static inline int trace_format_ref(char *p, char type, uint64_t vaddr) {
+	static const char hex[] = "0123456789abcdef";
+	int digits = 1, i;
+
+	while (digits < 16 && (vaddr >> (4 * digits)) != 0) {
+		digits++;
+	}
+	p[0] = type;
+	p[1] = ' ';
+	for (i = digits + 1; i >= 2; i--) {
+		p[i] = hex[vaddr & 0xf];
+		vaddr >>= 4;
+	}
+	p[digits + 2] = '\n';
+	return digits + 3;
+}
+
+#endif /* __TRACEIO_H__ */
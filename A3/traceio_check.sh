@@ -0,0 +1,42 @@
+#!/bin/bash
+# Checks that sim reads gzip, zstd and binary traces with the same counts
+# as the plain trace, and that it fails, rather than reporting a short run,
+# on a truncated gzip file, a corrupt zstd file and a truncated binary
+# trace. Exits with status 1 if a check fails.
+
+dir=$(mktemp -d traceio_check.XXXXXX)
+trap 'rm -rf $dir' EXIT
+status=0
+
+./tracegen -n 200000 -w 0.25 'zipf:8192:0.9+loop:3000' -o $dir/plain.ref
+./tracegen -n 200000 -w 0.25 'zipf:8192:0.9+loop:3000' -b -o $dir/binary.ref
+gzip -c $dir/plain.ref > $dir/gzip.ref
+head -c $(($(stat -c %s $dir/gzip.ref) / 2)) $dir/gzip.ref > $dir/truncated_gzip.ref
+head -c $(($(stat -c %s $dir/binary.ref) - 3)) $dir/binary.ref > $dir/truncated_binary.ref
+good="binary gzip"
+bad="truncated_gzip truncated_binary"
+if command -v zstd > /dev/null; then
+	zstd -qc $dir/plain.ref > $dir/zstd.ref
+	cp $dir/zstd.ref $dir/corrupt_zstd.ref
+	printf '\0\0\0\0\0\0\0\0' | dd of=$dir/corrupt_zstd.ref bs=1 \
+		seek=$(($(stat -c %s $dir/zstd.ref) / 2)) conv=notrunc 2> /dev/null
+	good="$good zstd"
+	bad="$bad corrupt_zstd"
+fi
+
+expected=$(./sim -f $dir/plain.ref -m 500 -a rand | tail --lines=7)
+for name in $good; do
+	if [ "$(./sim -f $dir/$name.ref -m 500 -a rand | tail --lines=7)" != "$expected" ]; then
+		echo "MISMATCH: $name trace"
+		status=1
+	fi
+done
+for name in $bad; do
+	for cmd in "./sim -f $dir/$name.ref -m 500 -a rand" "./reusedist -f $dir/$name.ref"; do
+		if $cmd > /dev/null 2>&1; then
+			echo "FAILED: $cmd succeeded"
+			status=1
+		fi
+	done
+done
+exit $status
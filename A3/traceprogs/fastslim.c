@@ -0,0 +1,246 @@
+/* This program processes an address trace generated by the Valgrind lackey
+ * tool to create a reduced trace according to the Fastslim-Demand algorithm
+ * described in "FastSlim: prefetch-safe trace reduction for I/O cache
+ * simulation" by Wei Jin, Xiaobai Sun, and Jeffrey S. Chase in ACM
+ * Transactions on Modeling and Computer Simulation, Vol. 11, No. 2
+ * (April 2001), pages 125-160. http://doi.acm.org/10.1145/384169.384170
+ *
+ * It replaces fastslim.py and produces the same output. In particular, as
+ * in that script, a reference to a page that is already in the trace
+ * buffer is dropped, so each buffer-full of distinct pages is emitted in
+ * order of first reference, and the entries still in the buffer at the
+ * end of the input are not emitted.
+ *
+ * With --marker, only the region of interest between the stores to
+ * MARKER_START and MARKER_END is kept. The traced programs write the
+ * addresses of those two variables to a .marker file just before storing
+ * to MARKER_START, so the file is read the first time it can be, while
+ * references are still being dropped. Once the store to MARKER_END is
+ * seen, the buffer is emitted and the rest of the input is ignored.
+ *
+ * USAGE: fastslim [-k|--keepcode] [-b|--buffersize N] [-m|--marker file]
+ *                 [tracefile]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <getopt.h>
+
+#define IOBUFSIZE (1 << 20)
+#define PAGE_SHIFT 12
+
+// An entry in the trace buffer
+struct trace_item {
+	char reftype[3];
+	unsigned long pg;
+	int *slot;          // hash table slot that refers to this entry
+};
+
+// The trace buffer is an array of entries in timestamp order, so it can
+// be emitted without sorting, plus an open-addressing hash table of
+// indices into it to check whether a page is already buffered. The table
+// has at least twice as many slots as the buffer has entries.
+static struct trace_item *items;
+static int num_items;
+static int buffersize;
+
+static int *slots;                // index into items + 1, or 0 if empty
+static unsigned long slot_mask;
+
+// Region of interest given by a marker file
+enum { BEFORE_START, IN_REGION, AFTER_END };
+static char *marker_file = NULL;
+static int marker_loaded = 0;
+static unsigned long marker_start, marker_end;
+
+static inline unsigned long hash_pg(unsigned long pg) {
+	pg ^= pg >> 29;
+	pg *= 0xbf58476d1ce4e5b9UL;
+	pg ^= pg >> 32;
+	return pg;
+}
+
+// Returns the slot holding pg, or the empty slot where it would go
+static int *find_slot(unsigned long pg) {
+	unsigned long i = hash_pg(pg) & slot_mask;
+	while (slots[i] != 0 && items[slots[i] - 1].pg != pg) {
+		i = (i + 1) & slot_mask;
+	}
+	return &slots[i];
+}
+
+static void emit_in_ts_order() {
+	int i;
+	for (i = 0; i < num_items; i++) {
+		printf("%s %lx\n", items[i].reftype, items[i].pg << PAGE_SHIFT);
+		*items[i].slot = 0;
+	}
+	num_items = 0;
+}
+
+/* Parses one line of lackey output the way fastslim.py does: the type is
+ * the first two characters with blanks removed and the address is the hex
+ * number after the third character, up to the first comma. Returns 0 if
+ * the line has no address.
+ */
+static int parse_line(char *line, char *reftype, unsigned long *addr) {
+	char *p, *end, *comma = strchr(line, ',');
+	int n = 0;
+
+	for (p = line; p < line + 2 && *p != '\0'; p++) {
+		if (!isspace((unsigned char)*p)) {
+			reftype[n++] = *p;
+		}
+	}
+	reftype[n] = '\0';
+
+	if ((comma != NULL && comma - line < 3) || strlen(line) < 3) {
+		return 0;
+	}
+	p = line + 3;
+	while (isspace((unsigned char)*p)) {
+		p++;
+	}
+	if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X') &&
+	    isxdigit((unsigned char)p[2])) {
+		p += 2;
+	}
+	if (!isxdigit((unsigned char)*p)) {
+		return 0;
+	}
+	*addr = strtoul(p, &end, 16);
+	while (isspace((unsigned char)*end)) {
+		end++;
+	}
+	return *end == ',' || *end == '\0';
+}
+
+/* Tries to read the MARKER_START and MARKER_END addresses from the marker
+ * file, which may not have been written yet. Returns nonzero once it has
+ * succeeded.
+ */
+static int load_markers() {
+	FILE *mfp;
+
+	if (marker_loaded) {
+		return 1;
+	}
+	if ((mfp = fopen(marker_file, "r")) == NULL) {
+		return 0;
+	}
+	if (fscanf(mfp, "%lx %lx", &marker_start, &marker_end) == 2) {
+		marker_loaded = 1;
+	}
+	fclose(mfp);
+	return marker_loaded;
+}
+
+// Returns nonzero if the reference is a store
+static int is_store(char *reftype) {
+	return strcmp(reftype, "S") == 0 || strcmp(reftype, "M") == 0;
+}
+
+int main(int argc, char *argv[]) {
+	int opt, keepcode = 0, region;
+	char *line = NULL;
+	size_t linecap = 0;
+	FILE *fp = stdin;
+	unsigned long nslots = 2;
+	struct option long_opts[] = {
+		{"keepcode", no_argument, NULL, 'k'},
+		{"buffersize", required_argument, NULL, 'b'},
+		{"marker", required_argument, NULL, 'm'},
+		{NULL, 0, NULL, 0}
+	};
+	char *usage = "USAGE: fastslim [-k|--keepcode] [-b|--buffersize N] [-m|--marker file] [tracefile]\n";
+
+	buffersize = 4;
+	while ((opt = getopt_long(argc, argv, "kb:m:", long_opts, NULL)) != -1) {
+		switch (opt) {
+		case 'k':
+			keepcode = 1;
+			break;
+		case 'b':
+			buffersize = (int)strtol(optarg, NULL, 10);
+			break;
+		case 'm':
+			marker_file = optarg;
+			break;
+		default:
+			fprintf(stderr, "%s", usage);
+			exit(1);
+		}
+	}
+	if (buffersize < 1) {
+		fprintf(stderr, "%s", usage);
+		exit(1);
+	}
+	if (optind < argc && strcmp(argv[optind], "-") != 0) {
+		if ((fp = fopen(argv[optind], "r")) == NULL) {
+			perror("Error opening tracefile:");
+			exit(1);
+		}
+	}
+	setvbuf(fp, NULL, _IOFBF, IOBUFSIZE);
+	setvbuf(stdout, NULL, _IOFBF, IOBUFSIZE);
+
+	while (nslots < 2 * (unsigned long)buffersize) {
+		nslots *= 2;
+	}
+	slot_mask = nslots - 1;
+	slots = calloc(nslots, sizeof(int));
+	items = malloc(buffersize * sizeof(struct trace_item));
+	if (slots == NULL || items == NULL) {
+		perror("Failed to allocate trace buffer");
+		exit(1);
+	}
+
+	region = marker_file != NULL ? BEFORE_START : IN_REGION;
+	while (getline(&line, &linecap, fp) != -1) {
+		char reftype[3];
+		unsigned long addr, pg;
+		int *slot;
+
+		if (line[0] == '=') {
+			continue;
+		}
+		if (!parse_line(line, reftype, &addr)) {
+			continue;
+		}
+		if (region == BEFORE_START) {
+			if (!is_store(reftype) || !load_markers() ||
+			    addr != marker_start) {
+				continue;
+			}
+			region = IN_REGION;
+		}
+		if (strcmp(reftype, "I") == 0 && !keepcode) {
+			continue;
+		}
+
+		pg = addr >> PAGE_SHIFT;
+		slot = find_slot(pg);
+		if (*slot == 0) {
+			if (num_items == buffersize) {
+				emit_in_ts_order();
+				slot = find_slot(pg);
+			}
+			strcpy(items[num_items].reftype, reftype);
+			items[num_items].pg = pg;
+			items[num_items].slot = slot;
+			*slot = ++num_items;
+		}
+
+		if (marker_file != NULL && is_store(reftype) && addr == marker_end) {
+			region = AFTER_END;
+			emit_in_ts_order();
+			break;
+		}
+	}
+	if (region == BEFORE_START) {
+		fprintf(stderr, "fastslim: store to MARKER_START not found\n");
+	}
+
+	return 0;
+}
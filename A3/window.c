@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+#include "pagetable.h"
+#include "window.h"
+
+#define WINDOW_BUFSIZE (1 << 20)
+
+int window_size = 0;
+
+static FILE *window_fp;
+static char *window_buf;
+
+// Counter values at the start of the current window
+static unsigned long start_ref, start_hit, start_miss, start_clean, start_dirty;
+
+// Page table entries touched in the current window. Each has PG_WINDOW
+// set until the window ends, so a page is only counted once.
+static pgtbl_entry_t **touched;
+static int num_touched;
+
+/* Sets up windowed statistics with size references per window, written to
+ * path, or to stdout if path is NULL. A file is block buffered so that
+ * writing rows does not slow down the replay.
+ */
+void window_init(int size, char *path) {
+	window_size = size;
+	if (path == NULL) {
+		window_fp = stdout;
+	} else if ((window_fp = fopen(path, "w")) == NULL) {
+		perror("Error opening window file:");
+		exit(1);
+	}
+	touched = malloc(size * sizeof(pgtbl_entry_t *));
+	if (touched == NULL) {
+		perror("Failed to allocate window buffers");
+		exit(1);
+	}
+	// stdout keeps its own buffering, which the results share
+	if (window_fp != stdout) {
+		if ((window_buf = malloc(WINDOW_BUFSIZE)) == NULL) {
+			perror("Failed to allocate window buffers");
+			exit(1);
+		}
+		setvbuf(window_fp, window_buf, _IOFBF, WINDOW_BUFSIZE);
+	}
+
+	fprintf(window_fp, "refs,hits,misses,clean_evictions,dirty_evictions,"
+		"resident,swap_used,distinct_pages\n");
+}
+
+static void window_emit() {
+	int i;
+
+	fprintf(window_fp, "%lu,%lu,%lu,%lu,%lu,%u,%u,%d\n", ref_count,
+		hit_count - start_hit, miss_count - start_miss,
+		evict_clean_count - start_clean, evict_dirty_count - start_dirty,
+		frames_in_use(),
+		swap_slots_used(), num_touched);
+
+	for (i = 0; i < num_touched; i++) {
+		touched[i]->frame &= ~PG_WINDOW;
+	}
+	num_touched = 0;
+
+	start_ref = ref_count;
+	start_hit = hit_count;
+	start_miss = miss_count;
+	start_clean = evict_clean_count;
+	start_dirty = evict_dirty_count;
+}
+
+/* Called after each reference has been counted, with the page table entry
+ * of the referenced page.
+ */
+void window_ref(pgtbl_entry_t *p) {
+	if (!(p->frame & PG_WINDOW)) {
+		p->frame |= PG_WINDOW;
+		touched[num_touched++] = p;
+	}
+	if (ref_count - start_ref == (unsigned long)window_size) {
+		window_emit();
+	}
+}
+
+/* Writes the last, partial window if there is one and flushes the output.
+ */
+void window_finish() {
+	if (ref_count != start_ref) {
+		window_emit();
+	}
+	if (window_fp == stdout) {
+		fflush(window_fp);
+	} else {
+		fclose(window_fp);
+		free(window_buf);
+	}
+	free(touched);
+}
@@ -0,0 +1,20 @@
+#ifndef __WINDOW_H__
+#define __WINDOW_H__
+
+#include "pagetable.h"
+
+/* Windowed statistics, enabled with sim --window N.
+ *
+ * Every N references a CSV row is written with the hits, misses and
+ * evictions in that window, the number of resident pages and used swap
+ * slots at its end, and the number of distinct pages it touched.
+ * Resident pages are those in memory frames, not in the far tier.
+ */
+
+extern int window_size;
+
+extern void window_init(int size, char *path);
+extern void window_ref(pgtbl_entry_t *p);
+extern void window_finish(void);
+
+#endif /* __WINDOW_H__ */
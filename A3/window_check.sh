@@ -0,0 +1,26 @@
+#!/bin/bash
+# Checks that the resident page count in sim --window output never exceeds
+# the fast memory, including with a far memory tier (whose pages are not
+# resident) and with prefetching. Prints one line per run that fails,
+# including runs where sim exits with an error, and exits with status 1 if
+# there were any.
+# Usage: ./window_check.sh [traces...]
+
+traces=${@:-./traceprogs/tr-*.ref}
+status=0
+set -o pipefail  # a sim error fails the run too
+
+for trace in $traces; do
+	for opts in "" "--far-mem 30" "--far-mem 30 --prefetch seq" \
+		    "--prefetch stride"; do
+		for size in 8 50; do
+			if ! ./sim -f $trace -m $size -s 20000 -a rand --window 1000 $opts |
+			     awk -F, -v m=$size 'NR > 1 && NF == 8 && $6 > m { bad = 1 }
+						END { exit bad }'; then
+				echo "FAILED: $trace -m $size $opts"
+				status=1
+			fi
+		done
+	done
+done
+exit $status